@@ -0,0 +1,98 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "logging.h"
+
+#include "buf_pool.h"
+
+static uint8_t bufs[BUF_POOL_NUM_BUFS][BUF_POOL_BUF_LEN] __attribute__((aligned(4)));
+static uint8_t in_use[BUF_POOL_NUM_BUFS];
+static buf_pool_stats_t stats;
+
+int buf_pool_init(void)
+{
+    memset(in_use, 0x00, sizeof(in_use));
+
+    memset(&stats, 0x00, sizeof(stats));
+    stats.num_bufs = BUF_POOL_NUM_BUFS;
+    stats.buf_len = BUF_POOL_BUF_LEN;
+
+    return 0;
+}
+
+int buf_pool_acquire(buf_lease_t* lease, buf_pool_owner_t owner)
+{
+    int index = -1;
+
+    vTaskSuspendAll();
+
+    for (int i = 0; i < BUF_POOL_NUM_BUFS; i++) {
+        if (!in_use[i]) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index < 0) {
+        stats.failed++;
+        xTaskResumeAll();
+
+        LogWarn(("buf_pool_acquire: all %d buffers are in use", BUF_POOL_NUM_BUFS));
+        return -1;
+    }
+
+    in_use[index] = 1;
+
+    stats.in_use++;
+    if (stats.in_use > stats.peak) {
+        stats.peak = stats.in_use;
+    }
+
+    stats.owner_in_use[owner]++;
+    if (stats.owner_in_use[owner] > stats.owner_peak[owner]) {
+        stats.owner_peak[owner] = stats.owner_in_use[owner];
+    }
+
+    xTaskResumeAll();
+
+    lease->buf = bufs[index];
+    lease->len = BUF_POOL_BUF_LEN;
+    lease->owner = owner;
+
+    return 0;
+}
+
+void buf_pool_release(buf_lease_t* lease)
+{
+    if (lease->buf == NULL) {
+        return;
+    }
+
+    size_t index = (lease->buf - &bufs[0][0]) / BUF_POOL_BUF_LEN;
+
+    vTaskSuspendAll();
+
+    in_use[index] = 0;
+    stats.in_use--;
+    stats.owner_in_use[lease->owner]--;
+
+    xTaskResumeAll();
+
+    lease->buf = NULL;
+    lease->len = 0;
+}
+
+void buf_pool_get_stats(buf_pool_stats_t* stats_out)
+{
+    vTaskSuspendAll();
+    *stats_out = stats;
+    xTaskResumeAll();
+}
@@ -0,0 +1,53 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+
+#ifndef __BUF_POOL_H__
+#define __BUF_POOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// request and response buffers, one for the Web API client and one for the JSON body it sends
+#ifndef BUF_POOL_NUM_BUFS
+#define BUF_POOL_NUM_BUFS 2
+#endif
+
+#ifndef BUF_POOL_BUF_LEN
+#define BUF_POOL_BUF_LEN 2048
+#endif
+
+typedef enum {
+    BUF_POOL_OWNER_HTTPS,
+    BUF_POOL_OWNER_JSON,
+    BUF_POOL_OWNER_COUNT
+} buf_pool_owner_t;
+
+// a buffer is only used through the lease that acquired it
+typedef struct {
+    uint8_t* buf;
+    size_t len;
+    buf_pool_owner_t owner;
+} buf_lease_t;
+
+typedef struct {
+    size_t num_bufs;
+    size_t buf_len;
+    size_t in_use;
+    size_t peak;
+    size_t owner_in_use[BUF_POOL_OWNER_COUNT];
+    size_t owner_peak[BUF_POOL_OWNER_COUNT];
+    uint32_t failed;
+} buf_pool_stats_t;
+
+int buf_pool_init(void);
+
+int buf_pool_acquire(buf_lease_t* lease, buf_pool_owner_t owner);
+
+void buf_pool_release(buf_lease_t* lease);
+
+void buf_pool_get_stats(buf_pool_stats_t* stats);
+
+#endif
@@ -0,0 +1,130 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "logging.h"
+
+#include "dns_cache.h"
+
+typedef struct {
+    char host[DNS_CACHE_HOST_MAX_LEN];
+    ip_addr_t addr;
+    TickType_t expires;
+    int valid;
+} dns_cache_entry_t;
+
+// connections are set up from more than one task, entries are only
+// touched with the scheduler suspended
+static dns_cache_entry_t cache[DNS_CACHE_SIZE];
+static dns_cache_stats_t stats;
+
+static dns_cache_entry_t* dns_cache_find(const char* host)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        dns_cache_entry_t* entry = &cache[i];
+
+        if (!entry->valid) {
+            continue;
+        }
+
+        if ((int32_t)(now - entry->expires) >= 0) {
+            entry->valid = 0;
+            continue;
+        }
+
+        if (strcmp(entry->host, host) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+int dns_cache_lookup(const char* host, ip_addr_t* addr)
+{
+    vTaskSuspendAll();
+
+    dns_cache_entry_t* entry = dns_cache_find(host);
+
+    if (entry == NULL) {
+        stats.misses++;
+        xTaskResumeAll();
+
+        return 0;
+    }
+
+    ip_addr_copy(*addr, entry->addr);
+    stats.hits++;
+
+    xTaskResumeAll();
+
+    return 1;
+}
+
+void dns_cache_store(const char* host, const ip_addr_t* addr)
+{
+    if (strlen(host) >= DNS_CACHE_HOST_MAX_LEN) {
+        return;
+    }
+
+    vTaskSuspendAll();
+
+    dns_cache_entry_t* entry = dns_cache_find(host);
+
+    if (entry == NULL) {
+        // take a free slot, otherwise replace the entry closest to expiry
+        entry = &cache[0];
+
+        for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+            if (!cache[i].valid) {
+                entry = &cache[i];
+                break;
+            }
+
+            if ((int32_t)(cache[i].expires - entry->expires) < 0) {
+                entry = &cache[i];
+            }
+        }
+    }
+
+    strcpy(entry->host, host);
+    ip_addr_copy(entry->addr, *addr);
+    entry->expires = xTaskGetTickCount() + pdMS_TO_TICKS(DNS_CACHE_TTL_MS);
+    entry->valid = 1;
+
+    xTaskResumeAll();
+}
+
+void dns_cache_invalidate(const char* host)
+{
+    vTaskSuspendAll();
+
+    dns_cache_entry_t* entry = dns_cache_find(host);
+
+    if (entry != NULL) {
+        entry->valid = 0;
+        stats.invalidations++;
+    }
+
+    xTaskResumeAll();
+
+    if (entry != NULL) {
+        LogDebug(("dns_cache_invalidate: dropping cached address for %s", host));
+    }
+}
+
+void dns_cache_get_stats(dns_cache_stats_t* stats_out)
+{
+    vTaskSuspendAll();
+    *stats_out = stats;
+    xTaskResumeAll();
+}
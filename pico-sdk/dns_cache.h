@@ -0,0 +1,41 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+
+#ifndef __DNS_CACHE_H__
+#define __DNS_CACHE_H__
+
+#include <stdint.h>
+
+#include <lwip/ip_addr.h>
+
+#ifndef DNS_CACHE_SIZE
+#define DNS_CACHE_SIZE 4
+#endif
+
+#ifndef DNS_CACHE_HOST_MAX_LEN
+#define DNS_CACHE_HOST_MAX_LEN 64
+#endif
+
+// upper bound on how long an answer is kept, lwIP does not pass the record TTL on
+#ifndef DNS_CACHE_TTL_MS
+#define DNS_CACHE_TTL_MS 60000
+#endif
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t invalidations;
+} dns_cache_stats_t;
+
+int dns_cache_lookup(const char* host, ip_addr_t* addr);
+
+void dns_cache_store(const char* host, const ip_addr_t* addr);
+
+void dns_cache_invalidate(const char* host);
+
+void dns_cache_get_stats(dns_cache_stats_t* stats);
+
+#endif
@@ -0,0 +1,65 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+
+#include <string.h>
+#include <strings.h>
+
+#include "http_header.h"
+
+size_t http_header_len(const uint8_t* data, size_t len)
+{
+    for (size_t i = 3; i < len; i++) {
+        if (data[i] == '\n' && data[i - 1] == '\r' && data[i - 2] == '\n' && data[i - 3] == '\r') {
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+int http_header_field(const char* line, const char* line_end, size_t* name_len, const char** value, size_t* value_len)
+{
+    const char* colon = memchr(line, ':', line_end - line);
+
+    if (colon == NULL) {
+        return -1;
+    }
+
+    const char* start = colon + 1;
+    const char* end = line_end;
+
+    while (start < end && (*start == ' ' || *start == '\t')) {
+        start++;
+    }
+
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+
+    *name_len = colon - line;
+    *value = start;
+    *value_len = end - start;
+
+    return 0;
+}
+
+int http_header_is(const char* name, size_t name_len, const char* expected)
+{
+    return name_len == strlen(expected) && strncasecmp(name, expected, name_len) == 0;
+}
+
+int http_header_value_has(const char* value, size_t value_len, const char* token)
+{
+    size_t token_len = strlen(token);
+
+    for (size_t i = 0; i + token_len <= value_len; i++) {
+        if (strncasecmp(&value[i], token, token_len) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
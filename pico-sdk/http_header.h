@@ -0,0 +1,26 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+
+#ifndef __HTTP_HEADER_H__
+#define __HTTP_HEADER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// returns the length of the response header up to and including the blank line, 0 if it is incomplete
+size_t http_header_len(const uint8_t* data, size_t len);
+
+// splits the field from line to line_end into its name and value, without the
+// whitespace around the value, returns -1 if there is no colon
+int http_header_field(const char* line, const char* line_end, size_t* name_len, const char** value, size_t* value_len);
+
+// case-insensitive, as field names are
+int http_header_is(const char* name, size_t name_len, const char* expected);
+
+// case-insensitive search for token in a header value
+int http_header_value_has(const char* value, size_t value_len, const char* token);
+
+#endif
@@ -4,39 +4,984 @@
 //
 
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "pico/time.h"
+
+#include "http_header.h"
 #include "logging.h"
 
-#include "https_client.h"
+#include "https_client.h"
+#include "inflater.h"
+
+typedef struct {
+    tls_client_t tls;
+    char host[TLS_CLIENT_HOST_MAX_LEN];
+    TickType_t last_used;
+    int connected;
+    int in_use;
+} https_pool_entry_t;
+
+typedef enum {
+    HTTPS_BODY_STATE_DATA,
+    HTTPS_BODY_STATE_CHUNK_SIZE,
+    HTTPS_BODY_STATE_CHUNK_EXTENSION,
+    HTTPS_BODY_STATE_CHUNK_END,
+    HTTPS_BODY_STATE_TRAILER,
+    HTTPS_BODY_STATE_DONE
+} https_body_state_t;
+
+typedef enum {
+    HTTPS_GZIP_STATE_HEADER,
+    HTTPS_GZIP_STATE_EXTRA_LEN,
+    HTTPS_GZIP_STATE_EXTRA,
+    HTTPS_GZIP_STATE_NAME,
+    HTTPS_GZIP_STATE_COMMENT,
+    HTTPS_GZIP_STATE_HEADER_CRC,
+    HTTPS_GZIP_STATE_DATA,
+    HTTPS_GZIP_STATE_TRAILER,
+    HTTPS_GZIP_STATE_DONE
+} https_gzip_state_t;
+
+#define HTTPS_GZIP_FLAG_HCRC    0x02
+#define HTTPS_GZIP_FLAG_EXTRA   0x04
+#define HTTPS_GZIP_FLAG_NAME    0x08
+#define HTTPS_GZIP_FLAG_COMMENT 0x10
+
+// gzip (RFC 1952) member around the raw DEFLATE data the inflater decodes,
+// claimed by one client at a time
+typedef struct {
+    https_client_t* owner;
+    https_gzip_state_t state;
+    uint8_t header[10];
+    size_t count;
+    size_t extra_len;
+    uint8_t trailer[8];
+    inflater_t inflater;
+    uint8_t* window;
+} https_gzip_t;
+
+// decodes a streamed response body, by length, chunked or up to the connection close
+typedef struct {
+    https_client_t* client;
+    https_body_state_t state;
+    int gzip;
+    int chunked;
+    int until_close;
+    size_t remaining;
+    size_t digits;
+    size_t line_len;
+} https_body_t;
+
+static https_pool_entry_t pool[HTTPS_CLIENT_POOL_SIZE];
+static https_gzip_t gzip;
+
+static void https_pool_close(https_pool_entry_t* entry)
+{
+    tls_client_close(&entry->tls);
+    entry->connected = 0;
+    entry->in_use = 0;
+}
+
+static https_pool_entry_t* https_pool_acquire(https_client_t* client, const char* host, int* reused)
+{
+    https_pool_entry_t* slot = NULL;
+
+    https_client_pool_prune();
+
+    *reused = 0;
+
+    for (int i = 0; i < HTTPS_CLIENT_POOL_SIZE; i++) {
+        https_pool_entry_t* entry = &pool[i];
+
+        if (entry->in_use) {
+            continue;
+        }
+
+        if (entry->connected && strcmp(entry->host, host) == 0) {
+            if (tls_client_check_idle(&entry->tls) == 0) {
+                LogDebug(("https_pool_acquire: reusing connection to %s", host));
+
+                entry->in_use = 1;
+                *reused = 1;
+
+                return entry;
+            }
+
+            LogDebug(("https_pool_acquire: idle connection to %s was closed by server", host));
+            https_pool_close(entry);
+        }
+
+        // prefer an empty slot, otherwise evict the least recently used idle one
+        if (slot == NULL || (slot->connected && (!entry->connected || entry->last_used < slot->last_used))) {
+            slot = entry;
+        }
+    }
+
+    if (slot == NULL) {
+        LogError(("https_pool_acquire: all %d pooled connections are in use!", HTTPS_CLIENT_POOL_SIZE));
+        return NULL;
+    }
+
+    if (slot->connected) {
+        https_pool_close(slot);
+    }
+
+    if (strlen(host) >= sizeof(slot->host)) {
+        LogError(("https_pool_acquire: host name %s is too long!", host));
+        return NULL;
+    }
+
+    if (tls_client_init(&slot->tls, client->tls_config) != 0) {
+        tls_client_close(&slot->tls);
+        return NULL;
+    }
+
+    if (tls_client_connect(&slot->tls, host, "443") != 0) {
+        LogError(("https_pool_acquire: tls_client_connect failed!"));
+        tls_client_close(&slot->tls);
+        return NULL;
+    }
+
+    strcpy(slot->host, host);
+    slot->connected = 1;
+    slot->in_use = 1;
+
+    return slot;
+}
+
+static void https_pool_release(https_pool_entry_t* entry, int keep)
+{
+    if (!keep) {
+        https_pool_close(entry);
+        return;
+    }
+
+    entry->last_used = xTaskGetTickCount();
+    entry->in_use = 0;
+}
+
+void https_client_pool_prune(void)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    for (int i = 0; i < HTTPS_CLIENT_POOL_SIZE; i++) {
+        https_pool_entry_t* entry = &pool[i];
+
+        if (entry->connected && !entry->in_use && (now - entry->last_used) >= pdMS_TO_TICKS(HTTPS_CLIENT_POOL_IDLE_TIMEOUT_MS)) {
+            LogDebug(("https_client_pool_prune: closing idle connection to %s", entry->host));
+            https_pool_close(entry);
+        }
+    }
+}
+
+// coreHTTP transport, counts what is written so a failed request is only sent again if it did not all go out
+static int32_t https_client_transport_send(NetworkContext_t* context, const void* data, size_t len)
+{
+    https_client_t* client = (https_client_t*)context;
+    int result = tls_client_write(client->transport_tls, data, len);
+
+    if (result > 0) {
+        client->request_sent += result;
+    }
+
+    return result;
+}
+
+static int32_t https_client_transport_recv(NetworkContext_t* context, void* data, size_t len)
+{
+    https_client_t* client = (https_client_t*)context;
+
+    return tls_client_read(client->transport_tls, data, len);
+}
+
+int https_client_init(https_client_t* client, tls_config_t* tls_config)
+{
+    client->tls_config = tls_config;
+    client->tls.sock = -1;
+    client->keep_alive = 0;
+    client->gzip = 0;
+    client->gzip_claimed = 0;
+    memset(&client->gzip_stats, 0x00, sizeof(client->gzip_stats));
+    client->body_consumer = NULL;
+    client->body_consumer_arg = NULL;
+
+    client->body_producer = NULL;
+    client->body_producer_arg = NULL;
+    client->body_producer_len = 0;
+    client->body_produced = 0;
+
+    client->lease.buf = NULL;
+    client->lease.len = 0;
+
+    client->retry_after = 0;
+
+    client->request_headers.pBuffer = NULL;
+    client->request_headers.bufferLen = 0;
+    client->request_headers.headersLen = 0;
+
+    client->transport_inferface.pNetworkContext = (NetworkContext_t*)client;
+    client->transport_inferface.recv = https_client_transport_recv;
+    client->transport_inferface.send = https_client_transport_send;
+    client->transport_tls = NULL;
+    client->request_written = 0;
+    client->request_sent = 0;
+
+    client->response.pBuffer = NULL;
+    client->response.bufferLen = 0;
+    client->response.getTime = NULL;
+
+    return 0;
+}
+
+// requests lease a buffer when they start, streamed requests return it when
+// they are done, a buffered response is kept until the next request or until
+// https_client_release_buffer is called
+int https_client_acquire_buffer(https_client_t* client)
+{
+    if (client->lease.buf != NULL) {
+        return 0;
+    }
+
+    if (buf_pool_acquire(&client->lease, BUF_POOL_OWNER_HTTPS) != 0) {
+        LogError(("https_client_acquire_buffer: buf_pool_acquire failed!"));
+        return -1;
+    }
+
+    client->request_headers.pBuffer = client->lease.buf;
+    client->request_headers.bufferLen = client->lease.len;
+    client->request_headers.headersLen = 0;
+
+    client->response.pBuffer = client->lease.buf;
+    client->response.bufferLen = client->lease.len;
+
+    return 0;
+}
+
+static void https_client_gzip_release(https_client_t* client);
+
+void https_client_release_buffer(https_client_t* client)
+{
+    // the gzip decoder is only held along with the buffer
+    https_client_gzip_release(client);
+
+    buf_pool_release(&client->lease);
+
+    client->request_headers.pBuffer = NULL;
+    client->request_headers.bufferLen = 0;
+
+    client->response.pBuffer = NULL;
+    client->response.bufferLen = 0;
+    client->response.pBody = NULL;
+    client->response.bodyLen = 0;
+}
+
+void https_client_set_keep_alive(https_client_t* client, int keep_alive)
+{
+    client->keep_alive = keep_alive;
+}
+
+void https_client_set_body_consumer(https_client_t* client, https_body_consumer_t consumer, void* arg)
+{
+    client->body_consumer = consumer;
+    client->body_consumer_arg = arg;
+}
+
+int https_client_set_gzip(https_client_t* client, int enabled)
+{
+    // the window is only paid for once a client turns gzip on
+    if (enabled && gzip.window == NULL) {
+        gzip.window = malloc(1 << HTTPS_CLIENT_GZIP_WINDOW_BITS);
+
+        if (gzip.window == NULL) {
+            LogError(("https_client_set_gzip: failed to allocate %d byte window!", 1 << HTTPS_CLIENT_GZIP_WINDOW_BITS));
+            client->gzip = 0;
+            return -1;
+        }
+
+        LogDebug(("https_client_set_gzip: allocated %d byte window, decoder state = %u bytes", 1 << HTTPS_CLIENT_GZIP_WINDOW_BITS, (unsigned int)sizeof(gzip)));
+    }
+
+    client->gzip = enabled;
+
+    return 0;
+}
+
+void https_client_get_gzip_stats(https_client_t* client, https_gzip_stats_t* stats)
+{
+    memcpy(stats, &client->gzip_stats, sizeof(*stats));
+}
+
+static int https_client_gunzipped(void* arg, const uint8_t* data, size_t len);
+
+// takes the gzip decoder for a request whose response is streamed, returns 0 if gzip is not offered
+static int https_client_gzip_claim(https_client_t* client, int streamed)
+{
+    if (!client->gzip || !streamed) {
+        return 0;
+    }
+
+    if (!client->gzip_claimed) {
+        vTaskSuspendAll();
+
+        if (gzip.owner == NULL) {
+            gzip.owner = client;
+            client->gzip_claimed = 1;
+        }
+
+        xTaskResumeAll();
+
+        if (!client->gzip_claimed) {
+            // another client is using it, this response comes uncompressed
+            return 0;
+        }
+
+        inflater_init(&gzip.inflater, gzip.window, HTTPS_CLIENT_GZIP_WINDOW_BITS, https_client_gunzipped, client);
+    }
+
+    return 1;
+}
+
+static void https_client_gzip_release(https_client_t* client)
+{
+    if (client->gzip_claimed) {
+        client->gzip_claimed = 0;
+        gzip.owner = NULL;
+    }
+}
+
+static void https_client_gzip_start(https_client_t* client)
+{
+    gzip.state = HTTPS_GZIP_STATE_HEADER;
+    gzip.count = 0;
+
+    inflater_reset(&gzip.inflater);
+
+    memset(&client->gzip_stats, 0x00, sizeof(client->gzip_stats));
+}
+
+static int https_client_gunzipped(void* arg, const uint8_t* data, size_t len)
+{
+    https_client_t* client = (https_client_t*)arg;
+
+    client->gzip_stats.inflated_bytes += len;
+
+    if (client->body_consumer == NULL) {
+        return 0;
+    }
+
+    return client->body_consumer(client->body_consumer_arg, data, len);
+}
+
+static uint32_t https_client_le32(const uint8_t* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+// undoes the gzip member framing and inflates the data inside it
+static int https_client_gunzip(https_client_t* client, const uint8_t* data, size_t len)
+{
+    size_t i = 0;
+
+    while (i < len) {
+        uint8_t c = data[i];
+
+        switch (gzip.state) {
+            case HTTPS_GZIP_STATE_HEADER:
+                gzip.header[gzip.count++] = c;
+
+                if (gzip.count == sizeof(gzip.header)) {
+                    if (gzip.header[0] != 0x1f || gzip.header[1] != 0x8b || gzip.header[2] != 8) {
+                        LogError(("https_client_gunzip: not a gzip member"));
+                        return -1;
+                    }
+
+                    gzip.count = 0;
+                    gzip.extra_len = 0;
+                    gzip.state = HTTPS_GZIP_STATE_EXTRA_LEN;
+                }
+                break;
+
+            case HTTPS_GZIP_STATE_EXTRA_LEN:
+                if (!(gzip.header[3] & HTTPS_GZIP_FLAG_EXTRA)) {
+                    gzip.state = HTTPS_GZIP_STATE_NAME;
+                    continue;
+                }
+
+                gzip.extra_len |= (size_t)c << (8 * gzip.count++);
+
+                if (gzip.count == 2) {
+                    gzip.state = HTTPS_GZIP_STATE_EXTRA;
+                }
+                break;
+
+            case HTTPS_GZIP_STATE_EXTRA:
+                if (gzip.extra_len == 0) {
+                    gzip.state = HTTPS_GZIP_STATE_NAME;
+                    continue;
+                }
+
+                gzip.extra_len--;
+                break;
+
+            case HTTPS_GZIP_STATE_NAME:
+            case HTTPS_GZIP_STATE_COMMENT:
+                if (!(gzip.header[3] & ((gzip.state == HTTPS_GZIP_STATE_NAME) ? HTTPS_GZIP_FLAG_NAME : HTTPS_GZIP_FLAG_COMMENT))) {
+                    gzip.state++;
+                    gzip.count = 0;
+                    continue;
+                }
+
+                if (c == '\0') {
+                    // the field is done, the next one is checked for without it
+                    gzip.header[3] &= (gzip.state == HTTPS_GZIP_STATE_NAME) ? ~HTTPS_GZIP_FLAG_NAME : ~HTTPS_GZIP_FLAG_COMMENT;
+                }
+                break;
+
+            case HTTPS_GZIP_STATE_HEADER_CRC:
+                if (!(gzip.header[3] & HTTPS_GZIP_FLAG_HCRC) || gzip.count == 2) {
+                    gzip.state = HTTPS_GZIP_STATE_DATA;
+                    continue;
+                }
+
+                gzip.count++;
+                break;
+
+            case HTTPS_GZIP_STATE_DATA: {
+                uint64_t start = time_us_64();
+                int used = inflater_write(&gzip.inflater, &data[i], len - i);
+
+                client->gzip_stats.inflate_us += time_us_64() - start;
+
+                if (used < 0) {
+                    LogError(("https_client_gunzip: could not inflate response"));
+                    return -1;
+                }
+
+                i += used;
+
+                if (inflater_finished(&gzip.inflater)) {
+                    gzip.count = 0;
+                    gzip.state = HTTPS_GZIP_STATE_TRAILER;
+                }
+                continue;
+            }
+
+            case HTTPS_GZIP_STATE_TRAILER:
+                gzip.trailer[gzip.count++] = c;
+
+                if (gzip.count == sizeof(gzip.trailer)) {
+                    // the CRC is left to TLS, which already protects the data
+                    if (https_client_le32(&gzip.trailer[4]) != client->gzip_stats.inflated_bytes) {
+                        LogError(("https_client_gunzip: inflated %u bytes, expected %u", client->gzip_stats.inflated_bytes, https_client_le32(&gzip.trailer[4])));
+                        return -1;
+                    }
+
+                    gzip.state = HTTPS_GZIP_STATE_DONE;
+                }
+                break;
+
+            case HTTPS_GZIP_STATE_DONE:
+                LogError(("https_client_gunzip: data after the gzip member"));
+                return -1;
+        }
+
+        i++;
+    }
+
+    return 0;
+}
+
+static int https_client_write_all(tls_client_t* tls, const uint8_t* data, size_t len)
+{
+    while (len > 0) {
+        int result = tls_client_write(tls, data, len);
+
+        if (result < 0) {
+            LogError(("https_client_write_all: tls_client_write failed, result = -0x%x", -result));
+            return -1;
+        }
+
+        data += result;
+        len -= result;
+    }
+
+    return 0;
+}
+
+// Retry-After in delay-seconds, the HTTP-date form is not used by the servers we talk to
+static uint32_t https_client_parse_retry_after(const char* value, size_t value_len)
+{
+    uint32_t seconds = 0;
+
+    for (size_t i = 0; i < value_len && value[i] >= '0' && value[i] <= '9'; i++) {
+        seconds = seconds * 10 + (value[i] - '0');
+    }
+
+    return seconds;
+}
+
+// fills in the status code and picks how the body is framed
+static enum HTTPStatus https_client_parse_header(https_client_t* client, const uint8_t* header, size_t header_len, https_body_t* body)
+{
+    const char* line = (const char*)header;
+    const char* end = line + header_len;
+    const char* line_end = memchr(line, '\r', end - line);
+    int content_length = 0;
+
+    if (line_end - line < 12 || strncmp(line, "HTTP/1.", 7) != 0 || line[8] != ' ') {
+        LogError(("https_client_parse_header: invalid status line, %.*s", (int)(line_end - line), line));
+        return HTTPInvalidResponse;
+    }
+
+    client->response.statusCode = atoi(&line[9]);
+    client->response.respFlags = 0;
+    client->retry_after = 0;
+
+    memset(body, 0x00, sizeof(*body));
+    body->client = client;
+
+    for (line = line_end + 2; line < end; line = line_end + 2) {
+        line_end = memchr(line, '\r', end - line);
+
+        if (line_end == line) {
+            break;
+        }
+
+        size_t name_len;
+        const char* value;
+        size_t value_len;
+
+        if (http_header_field(line, line_end, &name_len, &value, &value_len) != 0) {
+            LogError(("https_client_parse_header: invalid header line, %.*s", (int)(line_end - line), line));
+            return HTTPInvalidResponse;
+        }
+
+        if (http_header_is(line, name_len, "Content-Length")) {
+            body->remaining = strtoul(value, NULL, 10);
+            content_length = 1;
+        } else if (http_header_is(line, name_len, "Transfer-Encoding")) {
+            body->chunked = http_header_value_has(value, value_len, "chunked");
+        } else if (http_header_is(line, name_len, "Content-Encoding")) {
+            if (http_header_value_has(value, value_len, "gzip")) {
+                if (!client->gzip_claimed) {
+                    LogError(("https_client_parse_header: gzip response to a request that did not offer it"));
+                    return HTTPInvalidResponse;
+                }
+
+                body->gzip = 1;
+                https_client_gzip_start(client);
+            }
+        } else if (http_header_is(line, name_len, "Connection")) {
+            if (http_header_value_has(value, value_len, "close")) {
+                client->response.respFlags |= HTTP_RESPONSE_CONNECTION_CLOSE_FLAG;
+            }
+        } else if (http_header_is(line, name_len, "Retry-After")) {
+            client->retry_after = https_client_parse_retry_after(value, value_len);
+        }
+    }
+
+    if (client->response.statusCode == 204 || client->response.statusCode == 304) {
+        body->state = HTTPS_BODY_STATE_DONE;
+    } else if (body->chunked) {
+        body->state = HTTPS_BODY_STATE_CHUNK_SIZE;
+    } else if (content_length) {
+        body->state = (body->remaining == 0) ? HTTPS_BODY_STATE_DONE : HTTPS_BODY_STATE_DATA;
+    } else {
+        body->state = HTTPS_BODY_STATE_DATA;
+        body->until_close = 1;
+        client->response.respFlags |= HTTP_RESPONSE_CONNECTION_CLOSE_FLAG;
+    }
+
+    return HTTPSuccess;
+}
+
+static int https_client_deliver(https_body_t* body, const uint8_t* data, size_t len)
+{
+    https_client_t* client = body->client;
+
+    if (body->gzip) {
+        client->gzip_stats.compressed_bytes += len;
+        return https_client_gunzip(client, data, len);
+    }
+
+    if (client->body_consumer == NULL) {
+        return 0;
+    }
+
+    return client->body_consumer(client->body_consumer_arg, data, len);
+}
+
+// passes the body bytes in data on, undoing chunked encoding, returns how many
+// bytes were part of the body, the rest belong to the next response
+static int https_client_body(https_body_t* body, const uint8_t* data, size_t len)
+{
+    size_t i = 0;
+
+    while (i < len && body->state != HTTPS_BODY_STATE_DONE) {
+        uint8_t c = data[i];
+
+        switch (body->state) {
+            case HTTPS_BODY_STATE_DATA: {
+                size_t n = len - i;
+
+                if (!body->until_close && n > body->remaining) {
+                    n = body->remaining;
+                }
+
+                if (https_client_deliver(body, &data[i], n) != 0) {
+                    return -1;
+                }
+
+                i += n;
+
+                if (!body->until_close) {
+                    body->remaining -= n;
+
+                    if (body->remaining == 0) {
+                        body->state = body->chunked ? HTTPS_BODY_STATE_CHUNK_END : HTTPS_BODY_STATE_DONE;
+                    }
+                }
+
+                continue;
+            }
+
+            case HTTPS_BODY_STATE_CHUNK_SIZE:
+            case HTTPS_BODY_STATE_CHUNK_EXTENSION:
+                if (c == '\n') {
+                    if (body->digits == 0) {
+                        LogError(("https_client_body: chunk without a size"));
+                        return -1;
+                    }
+
+                    body->digits = 0;
+                    body->line_len = 0;
+                    body->state = (body->remaining == 0) ? HTTPS_BODY_STATE_TRAILER : HTTPS_BODY_STATE_DATA;
+                } else if (body->state == HTTPS_BODY_STATE_CHUNK_EXTENSION || c == '\r' || c == ' ' || c == '\t') {
+                } else if (c == ';') {
+                    body->state = HTTPS_BODY_STATE_CHUNK_EXTENSION;
+                } else {
+                    int digit = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+
+                    if (digit < 0 || body->remaining > (SIZE_MAX >> 4)) {
+                        LogError(("https_client_body: invalid chunk size"));
+                        return -1;
+                    }
+
+                    body->remaining = (body->remaining << 4) | digit;
+                    body->digits++;
+                }
+                break;
+
+            case HTTPS_BODY_STATE_CHUNK_END:
+                if (c == '\n') {
+                    body->remaining = 0;
+                    body->state = HTTPS_BODY_STATE_CHUNK_SIZE;
+                } else if (c != '\r') {
+                    LogError(("https_client_body: chunk is longer than its size"));
+                    return -1;
+                }
+                break;
+
+            case HTTPS_BODY_STATE_TRAILER:
+                if (c == '\n') {
+                    if (body->line_len == 0) {
+                        body->state = HTTPS_BODY_STATE_DONE;
+                    }
+
+                    body->line_len = 0;
+                } else if (c != '\r') {
+                    body->line_len++;
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        i++;
+    }
+
+    return i;
+}
+
+// sends the body the producer makes, as it is made, through the request buffer
+// that the headers were sent from, so memory does not grow with the body size
+static int https_client_write_produced(https_client_t* client, tls_client_t* tls)
+{
+    uint8_t* buf = client->request_headers.pBuffer;
+    size_t buf_len = client->request_headers.bufferLen;
+    int chunked = (client->body_producer_len == HTTPS_CLIENT_CHUNKED);
+    // chunks have a fixed width size line in front and a line break after
+    size_t prefix_len = chunked ? 10 : 0;
+    size_t suffix_len = chunked ? 2 : 0;
+
+    client->body_produced = 0;
+
+    while (1) {
+        int result = client->body_producer(client->body_producer_arg, &buf[prefix_len], buf_len - prefix_len - suffix_len);
+
+        if (result < 0) {
+            LogError(("https_client_write_produced: body producer failed!"));
+            return -1;
+        } else if (result == 0) {
+            break;
+        }
+
+        size_t len = result;
+
+        if (!chunked && len > client->body_producer_len - client->body_produced) {
+            LogError(("https_client_write_produced: body is longer than %u bytes", (unsigned int)client->body_producer_len));
+            return -1;
+        }
+
+        if (chunked) {
+            static const char hex[] = "0123456789abcdef";
+
+            for (int i = 0; i < 8; i++) {
+                buf[i] = hex[(len >> ((7 - i) * 4)) & 0xf];
+            }
+            memcpy(&buf[8], "\r\n", 2);
+            memcpy(&buf[prefix_len + len], "\r\n", 2);
+        }
+
+        if (https_client_write_all(tls, buf, prefix_len + len + suffix_len) != 0) {
+            return -1;
+        }
+
+        client->body_produced += len;
+    }
+
+    if (chunked) {
+        return https_client_write_all(tls, (const uint8_t*)"0\r\n\r\n", 5);
+    }
+
+    if (client->body_produced != client->body_producer_len) {
+        LogError(("https_client_write_produced: body ended after %u of %u bytes", (unsigned int)client->body_produced, (unsigned int)client->body_producer_len));
+        return -1;
+    }
+
+    return 0;
+}
+
+static int https_client_write_request(https_client_t* client, tls_client_t* tls, const char* body, size_t body_len)
+{
+    if (https_client_write_all(tls, client->request_headers.pBuffer, client->request_headers.headersLen) != 0) {
+        return -1;
+    }
+
+    if (client->body_producer != NULL) {
+        return https_client_write_produced(client, tls);
+    }
+
+    return https_client_write_all(tls, (const uint8_t*)body, body_len);
+}
+
+// reads one response and streams its body to the body consumer, using the
+// request buffer so memory does not grow with the response size, the first
+// pending bytes of the buffer were already received and bytes received past
+// the end of the response are left there for the next one
+static enum HTTPStatus https_client_read_response(https_client_t* client, tls_client_t* tls, size_t* pending)
+{
+    uint8_t* buf = client->response.pBuffer;
+    size_t buf_len = client->response.bufferLen;
+    size_t len = *pending;
+    size_t header_len;
+
+    *pending = 0;
+    client->response.statusCode = 0;
+    client->retry_after = 0;
+
+    while ((header_len = http_header_len(buf, len)) == 0) {
+        if (len == buf_len) {
+            LogError(("https_client_read_response: response header is larger than buffer size %d", (int)buf_len));
+            return HTTPSecurityAlertResponseHeadersSizeLimitExceeded;
+        }
+
+        int result = tls_client_read(tls, &buf[len], buf_len - len);
+
+        if (result <= 0) {
+            return (len == 0) ? HTTPNoResponse : HTTPNetworkError;
+        }
+
+        len += result;
+    }
+
+    https_body_t response_body;
+    enum HTTPStatus status = https_client_parse_header(client, buf, header_len, &response_body);
 
-int https_client_init(
-    https_client_t* client,
-    const unsigned char* root_ca,
-    size_t root_ca_len,
-    char* buf, size_t buf_len
-)
+    if (status != HTTPSuccess) {
+        return status;
+    }
+
+    int used = https_client_body(&response_body, &buf[header_len], len - header_len);
+
+    if (used < 0) {
+        return HTTPInvalidResponse;
+    }
+
+    while (response_body.state != HTTPS_BODY_STATE_DONE) {
+        int result = tls_client_read(tls, buf, buf_len);
+
+        if (result == 0 || result == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+            if (response_body.until_close) {
+                break;
+            }
+
+            LogError(("https_client_read_response: connection closed before the end of the body"));
+            return HTTPNetworkError;
+        } else if (result < 0) {
+            return HTTPNetworkError;
+        }
+
+        header_len = 0;
+        len = result;
+        used = https_client_body(&response_body, buf, len);
+
+        if (used < 0) {
+            return HTTPInvalidResponse;
+        }
+    }
+
+    *pending = len - header_len - used;
+    memmove(buf, &buf[header_len + used], *pending);
+
+    if (response_body.gzip && gzip.state != HTTPS_GZIP_STATE_DONE) {
+        LogError(("https_client_read_response: gzip response ended early"));
+        return HTTPInvalidResponse;
+    }
+
+    client->response.pBody = NULL;
+    client->response.bodyLen = 0;
+
+    return HTTPSuccess;
+}
+
+static enum HTTPStatus https_client_send_streamed(https_client_t* client, tls_client_t* tls, const char* body, size_t body_len)
 {
-    if (tls_client_init(&client->tls, root_ca, root_ca_len) != 0) {
-        return -1;
+    size_t pending = 0;
+
+    if (https_client_write_request(client, tls, body, body_len) != 0) {
+        return HTTPNetworkError;
     }
 
-    client->request_headers.pBuffer = buf;
-    client->request_headers.bufferLen = buf_len;
-    client->request_headers.headersLen = 0;
+    client->request_written = 1;
 
-    client->transport_inferface.recv = (TransportRecv_t)tls_client_read;
-    client->transport_inferface.send = (TransportSend_t)tls_client_write;
-    client->transport_inferface.pNetworkContext = (NetworkContext_t*)&client->tls;
+    return https_client_read_response(client, tls, &pending);
+}
 
-    client->response.pBuffer = buf;
-    client->response.bufferLen = buf_len;
-    client->response.getTime = NULL;
+static enum HTTPStatus https_client_send(https_client_t* client, tls_client_t* tls, const char* body, size_t body_len, uint32_t send_flags)
+{
+    client->transport_tls = tls;
+    client->request_written = 0;
+    client->request_sent = 0;
 
-    return 0;
+    if (client->body_consumer != NULL || client->body_producer != NULL) {
+        return https_client_send_streamed(client, tls, body, body_len);
+    }
+
+    enum HTTPStatus status = HTTPClient_Send(
+        &client->transport_inferface,
+        &client->request_headers,
+        body,
+        body_len,
+        &client->response,
+        send_flags
+    );
+
+    client->request_written = (client->request_sent == client->request_headers.headersLen + body_len);
+
+    const char* retry_after;
+    size_t retry_after_len;
+
+    client->retry_after = 0;
+
+    if (status == HTTPSuccess &&
+        HTTPClient_ReadHeader(&client->response, "Retry-After", strlen("Retry-After"), &retry_after, &retry_after_len) == HTTPSuccess) {
+        client->retry_after = https_client_parse_retry_after(retry_after, retry_after_len);
+    }
+
+    return status;
 }
 
-enum HTTPStatus https_client_request(
+static enum HTTPStatus https_client_send_pooled(https_client_t* client, const char* host, const char* body, size_t body_len, uint32_t send_flags)
+{
+    HTTPStatus_t status = HTTPNetworkError;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int reused;
+        https_pool_entry_t* entry = https_pool_acquire(client, host, &reused);
+
+        if (entry == NULL) {
+            return HTTPNetworkError;
+        }
+
+        status = https_client_send(client, &entry->tls, body, body_len, send_flags);
+
+        if (reused && (status == HTTPNetworkError || status == HTTPNoResponse) && !client->request_written && client->body_produced == 0) {
+            // the server closed the connection while it sat idle and the request
+            // did not all go out, so it cannot have been acted on, resend it on a
+            // fresh connection unless part of a produced body was already used up,
+            // a request that was written may have been, chat.postMessage would post twice
+            LogDebug(("https_client_send_pooled: reused connection to %s failed, reconnecting", host));
+            https_pool_release(entry, 0);
+            continue;
+        }
+
+        https_pool_release(
+            entry,
+            status == HTTPSuccess && !(client->response.respFlags & HTTP_RESPONSE_CONNECTION_CLOSE_FLAG)
+        );
+        break;
+    }
+
+    return status;
+}
+
+// sends the request in request_headers over a pooled or a new connection
+static enum HTTPStatus https_client_dispatch(https_client_t* client, const char* host, const char* body, size_t body_len, uint32_t send_flags)
+{
+    HTTPStatus_t status;
+
+    if (client->keep_alive) {
+        return https_client_send_pooled(client, host, body, body_len, send_flags);
+    }
+
+    // the connection may already have been set up with tls_client_connect_start
+    if (!tls_client_connected(&client->tls)) {
+        if (tls_client_init(&client->tls, client->tls_config) != 0) {
+            tls_client_close(&client->tls);
+            return HTTPNetworkError;
+        }
+
+        if (tls_client_connect(&client->tls, host, "443") != 0) {
+            LogError(("https_client_dispatch: tls_client_connect failed!"));
+            tls_client_close(&client->tls);
+            return HTTPNetworkError;
+        }
+    }
+
+    status = https_client_send(client, &client->tls, body, body_len, send_flags);
+
+    tls_client_close(&client->tls);
+
+    return status;
+}
+
+static void https_client_finish(https_client_t* client)
+{
+    // nothing points into a streamed response once the request is done
+    if (client->body_consumer != NULL) {
+        https_client_release_buffer(client);
+    }
+}
+
+static enum HTTPStatus https_client_send_request(
     https_client_t* client,
     const char* method,
     const char* host,
@@ -49,13 +994,15 @@ enum HTTPStatus https_client_request(
 {
     HTTPStatus_t status;
 
+    memset(&client->gzip_stats, 0x00, sizeof(client->gzip_stats));
+
     client->request_info.pMethod = method;
     client->request_info.methodLen = strlen(method);
     client->request_info.pPath = path;
     client->request_info.pathLen = strlen(path);
     client->request_info.pHost = host;
     client->request_info.hostLen = strlen(host);
-    client->request_info.reqFlags = 0;
+    client->request_info.reqFlags = client->keep_alive ? HTTP_REQUEST_KEEP_ALIVE_FLAG : 0;
 
     status = HTTPClient_InitializeRequestHeaders(&client->request_headers, &client->request_info);
     if (status != HTTPSuccess) {
@@ -77,27 +1024,64 @@ enum HTTPStatus https_client_request(
         }
     }
 
-    if (tls_client_connect(&client->tls, host, "443") != 0) {
-        LogError(("https_client_request: tls_client_connect failed!"));
-        return HTTPNetworkError;
+    if (https_client_gzip_claim(client, client->body_consumer != NULL)) {
+        status = HTTPClient_AddHeader(
+            &client->request_headers,
+            "Accept-Encoding",
+            strlen("Accept-Encoding"),
+            "gzip",
+            strlen("gzip")
+        );
+
+        if (status != HTTPSuccess) {
+            LogError(("https_client_request: HTTPClient_AddHeader failed!"));
+            return status;
+        }
     }
 
-    status = HTTPClient_Send(
-        &client->transport_inferface,
-        &client->request_headers,
-        body,
-        body_len,
-        &client->response,
-        0
-    );
+    if (client->body_consumer != NULL && body_len > 0) {
+        // HTTPClient_Send adds this itself, streamed requests are sent without it
+        char content_length[12];
 
-    if (status == HTTPParserInternalError && client->response.statusCode == 101) {
-        status = HTTPSuccess;
-    } else {
-        tls_client_close(&client->tls);
+        snprintf(content_length, sizeof(content_length), "%u", (unsigned int)body_len);
+
+        status = HTTPClient_AddHeader(
+            &client->request_headers,
+            "Content-Length",
+            strlen("Content-Length"),
+            content_length,
+            strlen(content_length)
+        );
+
+        if (status != HTTPSuccess) {
+            LogError(("https_client_request: HTTPClient_AddHeader failed!"));
+            return status;
+        }
+    }
+
+    return https_client_dispatch(client, host, body, body_len, 0);
+}
+
+enum HTTPStatus https_client_request(
+    https_client_t* client,
+    const char* method,
+    const char* host,
+    const char* path,
+    const char* headers[],
+    size_t num_headers,
+    const char* body,
+    size_t body_len
+)
+{
+    if (https_client_acquire_buffer(client) != 0) {
+        return HTTPInsufficientMemory;
     }
 
-    return status;  
+    HTTPStatus_t status = https_client_send_request(client, method, host, path, headers, num_headers, body, body_len);
+
+    https_client_finish(client);
+
+    return status;
 }
 
 // TODO: create common function for POST and GET
@@ -142,3 +1126,314 @@ enum HTTPStatus https_client_get(
         0
     );
 }
+
+// appends one line made of four parts
+static int https_client_template_append(https_request_template_t* request_template, const char* a, const char* b, const char* c, const char* d)
+{
+    const char* parts[] = { a, b, c, d, "\r\n" };
+
+    for (int i = 0; i < 5; i++) {
+        size_t len = strlen(parts[i]);
+
+        if (request_template->header_len + len > sizeof(request_template->header)) {
+            LogError(("https_client_template_append: headers are larger than %d bytes", (int)sizeof(request_template->header)));
+            return -1;
+        }
+
+        memcpy(&request_template->header[request_template->header_len], parts[i], len);
+        request_template->header_len += len;
+    }
+
+    return 0;
+}
+
+// serializes the request line and headers like HTTPClient_InitializeRequestHeaders and
+// HTTPClient_AddHeader would, leaving out Content-Length and the final blank line
+int https_client_template_init(
+    https_client_t* client,
+    https_request_template_t* request_template,
+    const char* method,
+    const char* host,
+    const char* path,
+    const char* headers[],
+    size_t num_headers
+)
+{
+    request_template->host = host;
+    request_template->header_len = 0;
+
+    if (https_client_template_append(request_template, method, " ", path, " HTTP/1.1") != 0 ||
+        https_client_template_append(request_template, "User-Agent", ": ", HTTP_USER_AGENT_VALUE, "") != 0 ||
+        https_client_template_append(request_template, "Host", ": ", host, "") != 0) {
+        return -1;
+    }
+
+    if (client->keep_alive && https_client_template_append(request_template, "Connection", ": ", "keep-alive", "") != 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < num_headers; i++) {
+        if (https_client_template_append(request_template, headers[i * 2], ": ", headers[i * 2 + 1], "") != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// copies the template to the request buffer and adds Content-Length, the only
+// per request header, or Transfer-Encoding for HTTPS_CLIENT_CHUNKED
+static enum HTTPStatus https_client_prepare(https_client_t* client, const https_request_template_t* request_template, size_t body_len, int streamed)
+{
+    static const char accept_encoding[] = "Accept-Encoding: gzip\r\n";
+    static const char content_length[] = "Content-Length: ";
+    static const char chunked[] = "Transfer-Encoding: chunked";
+    uint8_t* buf = client->request_headers.pBuffer;
+    size_t accept_encoding_len = https_client_gzip_claim(client, streamed) ? sizeof(accept_encoding) - 1 : 0;
+    const char* header = content_length;
+    size_t header_len = sizeof(content_length) - 1;
+    char digits[10];
+    size_t num_digits = 0;
+
+    if (body_len == HTTPS_CLIENT_CHUNKED) {
+        header = chunked;
+        header_len = sizeof(chunked) - 1;
+    } else {
+        do {
+            digits[num_digits++] = '0' + (body_len % 10);
+            body_len /= 10;
+        } while (body_len > 0 && num_digits < sizeof(digits));
+    }
+
+    size_t len = request_template->header_len + accept_encoding_len + header_len + num_digits + 4;
+
+    if (len > client->request_headers.bufferLen) {
+        LogError(("https_client_template_prepare: request headers are larger than buffer size %d", (int)client->request_headers.bufferLen));
+        return HTTPInsufficientMemory;
+    }
+
+    memcpy(buf, request_template->header, request_template->header_len);
+    buf += request_template->header_len;
+
+    memcpy(buf, accept_encoding, accept_encoding_len);
+    buf += accept_encoding_len;
+
+    memcpy(buf, header, header_len);
+    buf += header_len;
+
+    while (num_digits > 0) {
+        *buf++ = digits[--num_digits];
+    }
+
+    memcpy(buf, "\r\n\r\n", 4);
+
+    client->request_headers.headersLen = len;
+
+    return HTTPSuccess;
+}
+
+enum HTTPStatus https_client_template_prepare(https_client_t* client, const https_request_template_t* request_template, size_t body_len)
+{
+    memset(&client->gzip_stats, 0x00, sizeof(client->gzip_stats));
+
+    return https_client_prepare(client, request_template, body_len, client->body_consumer != NULL || client->body_producer != NULL);
+}
+
+enum HTTPStatus https_client_template_send(
+    https_client_t* client,
+    const https_request_template_t* request_template,
+    const char* body,
+    size_t body_len
+)
+{
+    if (https_client_acquire_buffer(client) != 0) {
+        return HTTPInsufficientMemory;
+    }
+
+    HTTPStatus_t status = https_client_template_prepare(client, request_template, body_len);
+
+    if (status == HTTPSuccess) {
+        status = https_client_dispatch(client, request_template->host, body, body_len, HTTP_SEND_DISABLE_CONTENT_LENGTH_FLAG);
+    }
+
+    https_client_finish(client);
+
+    return status;
+}
+
+// sends a body that is made while it is sent, body_len is its length or
+// HTTPS_CLIENT_CHUNKED when that is not known up front, the response is read
+// like a streamed one and its body goes to the body consumer if there is one
+enum HTTPStatus https_client_template_send_produced(
+    https_client_t* client,
+    const https_request_template_t* request_template,
+    https_body_producer_t producer,
+    void* arg,
+    size_t body_len
+)
+{
+    if (https_client_acquire_buffer(client) != 0) {
+        return HTTPInsufficientMemory;
+    }
+
+    memset(&client->gzip_stats, 0x00, sizeof(client->gzip_stats));
+
+    HTTPStatus_t status = https_client_prepare(client, request_template, body_len, 1);
+
+    if (status == HTTPSuccess) {
+        client->body_producer = producer;
+        client->body_producer_arg = arg;
+        client->body_producer_len = body_len;
+        client->body_produced = 0;
+
+        status = https_client_dispatch(client, request_template->host, NULL, 0, 0);
+
+        client->body_producer = NULL;
+        client->body_producer_arg = NULL;
+        client->body_produced = 0;
+    }
+
+    // the response was streamed
+    https_client_release_buffer(client);
+
+    return status;
+}
+
+// writes requests back-to-back on one pooled connection and reads their responses in order
+static size_t https_client_pipeline_send(https_client_t* client, tls_client_t* tls, https_pipeline_request_t* requests, size_t num_requests)
+{
+    size_t sent = 0;
+
+    while (sent < num_requests) {
+        https_pipeline_request_t* request = &requests[sent];
+
+        // pipelined responses are always streamed
+        if (https_client_prepare(client, request->request_template, request->body_len, 1) != HTTPSuccess ||
+            https_client_write_request(client, tls, request->body, request->body_len) != 0) {
+            break;
+        }
+
+        request->written = 1;
+        sent++;
+    }
+
+    return sent;
+}
+
+static size_t https_client_pipeline_receive(https_client_t* client, tls_client_t* tls, https_pipeline_request_t* requests, size_t num_requests)
+{
+    https_body_consumer_t body_consumer = client->body_consumer;
+    void* body_consumer_arg = client->body_consumer_arg;
+    size_t pending = 0;
+    size_t answered = 0;
+
+    while (answered < num_requests) {
+        https_pipeline_request_t* request = &requests[answered];
+
+        client->body_consumer = request->body_consumer;
+        client->body_consumer_arg = request->body_consumer_arg;
+
+        enum HTTPStatus status = https_client_read_response(client, tls, &pending);
+
+        if (client->response.statusCode == 0) {
+            // no response header, the server may not have seen the request
+            break;
+        }
+
+        request->status = status;
+        request->status_code = client->response.statusCode;
+        request->retry_after = client->retry_after;
+        answered++;
+
+        if (status != HTTPSuccess || (client->response.respFlags & HTTP_RESPONSE_CONNECTION_CLOSE_FLAG)) {
+            break;
+        }
+    }
+
+    client->body_consumer = body_consumer;
+    client->body_consumer_arg = body_consumer_arg;
+
+    return answered;
+}
+
+// sends a burst of requests to one host with a single round trip, if the
+// connection fails partway through the requests that did not all go out are
+// sent again on a new connection, a request that was written is not resent
+// as the server may have acted on it, it is left with HTTPNoResponse
+static enum HTTPStatus https_client_pipeline_send_all(https_client_t* client, https_pipeline_request_t* requests, size_t num_requests)
+{
+    size_t next = 0;
+
+    const char* host = requests[0].request_template->host;
+
+    for (size_t i = 0; i < num_requests; i++) {
+        if (strcmp(requests[i].request_template->host, host) != 0) {
+            LogError(("https_client_pipeline: requests are not all to %s", host));
+            return HTTPInvalidParameter;
+        }
+
+        requests[i].status = HTTPNoResponse;
+        requests[i].status_code = 0;
+        requests[i].retry_after = 0;
+        requests[i].written = 0;
+    }
+
+    while (next < num_requests) {
+        int reused;
+        https_pool_entry_t* entry = https_pool_acquire(client, host, &reused);
+
+        if (entry == NULL) {
+            return HTTPNetworkError;
+        }
+
+        size_t sent = https_client_pipeline_send(client, &entry->tls, &requests[next], num_requests - next);
+        size_t answered = https_client_pipeline_receive(client, &entry->tls, &requests[next], sent);
+
+        https_pool_release(
+            entry,
+            sent == num_requests - next && answered == sent &&
+            requests[next + answered - 1].status == HTTPSuccess && !(client->response.respFlags & HTTP_RESPONSE_CONNECTION_CLOSE_FLAG)
+        );
+
+        if (answered < sent) {
+            LogError(("https_client_pipeline: no response from %s to %u written requests", host, (unsigned int)(sent - answered)));
+        }
+
+        next += sent;
+
+        if (sent == 0 && !reused) {
+            LogError(("https_client_pipeline: could not write to %s on a new connection", host));
+            return HTTPNetworkError;
+        }
+
+        if (next < num_requests) {
+            LogDebug(("https_client_pipeline: resending %u unwritten requests to %s", (unsigned int)(num_requests - next), host));
+        }
+    }
+
+    for (size_t i = 0; i < num_requests; i++) {
+        if (requests[i].status != HTTPSuccess) {
+            return requests[i].status;
+        }
+    }
+
+    return HTTPSuccess;
+}
+
+enum HTTPStatus https_client_pipeline(https_client_t* client, https_pipeline_request_t* requests, size_t num_requests)
+{
+    if (num_requests == 0) {
+        return HTTPSuccess;
+    }
+
+    if (https_client_acquire_buffer(client) != 0) {
+        return HTTPInsufficientMemory;
+    }
+
+    HTTPStatus_t status = https_client_pipeline_send_all(client, requests, num_requests);
+
+    // responses were all streamed to the request consumers
+    https_client_release_buffer(client);
+
+    return status;
+}
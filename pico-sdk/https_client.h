@@ -7,26 +7,150 @@
 #ifndef __HTTPS_CLIENT_H__
 #define __HTTPS_CLIENT_H__
 
+#include "buf_pool.h"
 #include "tls_client.h"
 #include "core_http_client.h"
 
+#ifndef HTTPS_CLIENT_POOL_SIZE
+#define HTTPS_CLIENT_POOL_SIZE 1
+#endif
+
+#ifndef HTTPS_CLIENT_POOL_IDLE_TIMEOUT_MS
+#define HTTPS_CLIENT_POOL_IDLE_TIMEOUT_MS 30000
+#endif
+
+// servers compress with a 32 KB window, a smaller one only decodes responses that do not refer further back,
+// the window is allocated the first time a client turns gzip on and kept from then on
+#ifndef HTTPS_CLIENT_GZIP_WINDOW_BITS
+#define HTTPS_CLIENT_GZIP_WINDOW_BITS 15
+#endif
+
+#ifndef HTTPS_CLIENT_TEMPLATE_MAX_LEN
+#define HTTPS_CLIENT_TEMPLATE_MAX_LEN 384
+#endif
+
+// body length of a request whose body is sent with chunked transfer encoding
+#define HTTPS_CLIENT_CHUNKED SIZE_MAX
+
+// receives a streamed response body piece by piece, returning non-zero aborts the request
+typedef int (*https_body_consumer_t)(void* arg, const uint8_t* data, size_t len);
+
+// fills buf with up to len bytes of a request body, returns how many, 0 at the end of the body or -1 on failure
+typedef int (*https_body_producer_t)(void* arg, uint8_t* buf, size_t len);
+
+// of the last request, all zero if its response was not compressed
+typedef struct {
+    uint32_t compressed_bytes;
+    uint32_t inflated_bytes;
+    uint32_t inflate_us;
+} https_gzip_stats_t;
+
 typedef struct {
+    tls_config_t* tls_config;
     tls_client_t tls;
+    int keep_alive;
+
+    // offer gzip for streamed responses, there is one decoder for all clients
+    int gzip;
+    int gzip_claimed;
+    https_gzip_stats_t gzip_stats;
+
+    // request and response buffer, leased from the buffer pool while a request is made
+    buf_lease_t lease;
+
+    // set to stream response bodies instead of buffering them whole
+    https_body_consumer_t body_consumer;
+    void* body_consumer_arg;
+
+    // set while a request body is sent from a producer
+    https_body_producer_t body_producer;
+    void* body_producer_arg;
+    size_t body_producer_len;
+    size_t body_produced;
 
     HTTPRequestHeaders_t request_headers;
     HTTPRequestInfo_t request_info;
     TransportInterface_t transport_inferface;
+    tls_client_t* transport_tls;
     HTTPResponse_t response;
+
+    // set once the whole request was written, a request the server may have acted on is not sent again
+    int request_written;
+    size_t request_sent;
+
+    // seconds from the Retry-After header of the last response, 0 if it had none
+    uint32_t retry_after;
 } https_client_t;
 
-int https_client_init(
+// request line and headers serialized once, for requests that only differ in their body
+typedef struct {
+    const char* host;
+    uint8_t header[HTTPS_CLIENT_TEMPLATE_MAX_LEN];
+    size_t header_len;
+} https_request_template_t;
+
+// one request of a pipelined burst, its response body goes to its own consumer
+typedef struct {
+    const https_request_template_t* request_template;
+    const char* body;
+    size_t body_len;
+    https_body_consumer_t body_consumer;
+    void* body_consumer_arg;
+
+    // HTTPNoResponse until the response to this request was read, a request
+    // that was written but never answered keeps it and is not sent again
+    enum HTTPStatus status;
+    int written;
+    uint16_t status_code;
+    uint32_t retry_after;
+} https_pipeline_request_t;
+
+int https_client_init(https_client_t* client, tls_config_t* tls_config);
+
+int https_client_acquire_buffer(https_client_t* client);
+
+void https_client_release_buffer(https_client_t* client);
+
+void https_client_set_keep_alive(https_client_t* client, int keep_alive);
+
+void https_client_set_body_consumer(https_client_t* client, https_body_consumer_t consumer, void* arg);
+
+// returns -1 if the gzip window cannot be allocated, the client then keeps responses uncompressed
+int https_client_set_gzip(https_client_t* client, int gzip);
+
+void https_client_get_gzip_stats(https_client_t* client, https_gzip_stats_t* stats);
+
+void https_client_pool_prune(void);
+
+int https_client_template_init(
     https_client_t* client,
-    const unsigned char* root_ca,
-    size_t root_ca_len,
-    char* buf,
-    size_t buf_len
+    https_request_template_t* request_template,
+    const char* method,
+    const char* host,
+    const char* path,
+    const char* headers[],
+    size_t num_headers
 );
 
+enum HTTPStatus https_client_template_prepare(https_client_t* client, const https_request_template_t* request_template, size_t body_len);
+
+enum HTTPStatus https_client_template_send(
+    https_client_t* client,
+    const https_request_template_t* request_template,
+    const char* body,
+    size_t body_len
+);
+
+enum HTTPStatus https_client_template_send_produced(
+    https_client_t* client,
+    const https_request_template_t* request_template,
+    https_body_producer_t producer,
+    void* arg,
+    size_t body_len
+);
+
+enum HTTPStatus https_client_pipeline(https_client_t* client, https_pipeline_request_t* requests, size_t num_requests);
+
 enum HTTPStatus https_client_post(
     https_client_t* client,
     const char* host,
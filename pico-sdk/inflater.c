@@ -0,0 +1,566 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+#include <string.h>
+
+#include "logging.h"
+
+#include "inflater.h"
+
+#define INFLATER_MAX_BITS 15
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// order the code length code lengths are sent in
+static const uint8_t code_length_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+void inflater_init(inflater_t* inflater, uint8_t* window, unsigned int window_bits, inflater_output_t output, void* arg)
+{
+    inflater->window = window;
+    inflater->window_size = (size_t)1 << window_bits;
+    inflater->output = output;
+    inflater->output_arg = arg;
+
+    inflater_reset(inflater);
+}
+
+void inflater_reset(inflater_t* inflater)
+{
+    inflater->state = INFLATER_STATE_HEADER;
+    inflater->final = 0;
+    inflater->bits = 0;
+    inflater->bit_count = 0;
+    inflater->window_pos = 0;
+    inflater->window_have = 0;
+    inflater->flush_pos = 0;
+}
+
+int inflater_finished(inflater_t* inflater)
+{
+    return (inflater->state == INFLATER_STATE_DONE);
+}
+
+// bytes are only pulled in when needed, so nothing past the final block is used up
+static int inflater_need(inflater_t* inflater, unsigned int count)
+{
+    while (inflater->bit_count < count) {
+        if (inflater->in_pos == inflater->in_len) {
+            return 0;
+        }
+
+        inflater->bits |= (uint32_t)inflater->in[inflater->in_pos++] << inflater->bit_count;
+        inflater->bit_count += 8;
+    }
+
+    return 1;
+}
+
+static unsigned int inflater_take(inflater_t* inflater, unsigned int count)
+{
+    unsigned int value = inflater->bits & ((1UL << count) - 1);
+
+    inflater->bits >>= count;
+    inflater->bit_count -= count;
+
+    return value;
+}
+
+// builds a canonical Huffman code, returns 0 if complete, > 0 if incomplete and -1 if over-subscribed
+static int inflater_build(uint16_t* count, uint16_t* symbol, const uint8_t* lengths, unsigned int num)
+{
+    uint16_t offsets[INFLATER_MAX_BITS + 1];
+
+    memset(count, 0x00, sizeof(uint16_t) * (INFLATER_MAX_BITS + 1));
+
+    for (unsigned int i = 0; i < num; i++) {
+        count[lengths[i]]++;
+    }
+
+    if (count[0] == num) {
+        return 0;
+    }
+
+    int left = 1;
+
+    for (int len = 1; len <= INFLATER_MAX_BITS; len++) {
+        left <<= 1;
+        left -= count[len];
+
+        if (left < 0) {
+            return -1;
+        }
+    }
+
+    offsets[1] = 0;
+    for (int len = 1; len < INFLATER_MAX_BITS; len++) {
+        offsets[len + 1] = offsets[len] + count[len];
+    }
+
+    for (unsigned int i = 0; i < num; i++) {
+        if (lengths[i] != 0) {
+            symbol[offsets[lengths[i]]++] = i;
+        }
+    }
+
+    return left;
+}
+
+// returns the next symbol, -1 if more input is needed and -2 for an invalid code
+static int inflater_decode(inflater_t* inflater, const uint16_t* count, const uint16_t* symbol)
+{
+    int code = 0;
+    int first = 0;
+    int index = 0;
+
+    for (unsigned int len = 1; len <= INFLATER_MAX_BITS; len++) {
+        if (!inflater_need(inflater, len)) {
+            return -1;
+        }
+
+        code |= (inflater->bits >> (len - 1)) & 1;
+
+        int num = count[len];
+
+        if (code - num < first) {
+            inflater_take(inflater, len);
+
+            return symbol[index + (code - first)];
+        }
+
+        index += num;
+        first += num;
+        first <<= 1;
+        code <<= 1;
+    }
+
+    return -2;
+}
+
+// passes everything since the last flush on, starting over at the beginning of a full window
+static int inflater_flush(inflater_t* inflater)
+{
+    size_t len = inflater->window_pos - inflater->flush_pos;
+
+    if (len > 0 && inflater->output(inflater->output_arg, &inflater->window[inflater->flush_pos], len) != 0) {
+        return -1;
+    }
+
+    if (inflater->window_pos == inflater->window_size) {
+        inflater->window_pos = 0;
+    }
+
+    inflater->flush_pos = inflater->window_pos;
+
+    return 0;
+}
+
+static int inflater_put(inflater_t* inflater, uint8_t c)
+{
+    inflater->window[inflater->window_pos++] = c;
+
+    if (inflater->window_have < inflater->window_size) {
+        inflater->window_have++;
+    }
+
+    if (inflater->window_pos == inflater->window_size) {
+        return inflater_flush(inflater);
+    }
+
+    return 0;
+}
+
+static int inflater_copy(inflater_t* inflater, unsigned int distance, unsigned int len)
+{
+    if (distance > inflater->window_have) {
+        LogError(("inflater_write: distance %u is further back than the window", distance));
+        return -1;
+    }
+
+    size_t mask = inflater->window_size - 1;
+    size_t from = (inflater->window_pos + inflater->window_size - distance) & mask;
+
+    for (unsigned int i = 0; i < len; i++) {
+        if (inflater_put(inflater, inflater->window[from]) != 0) {
+            return -1;
+        }
+
+        from = (from + 1) & mask;
+    }
+
+    return 0;
+}
+
+static void inflater_fixed_tables(inflater_t* inflater)
+{
+    unsigned int i = 0;
+
+    for (; i < 144; i++) {
+        inflater->lengths[i] = 8;
+    }
+    for (; i < 256; i++) {
+        inflater->lengths[i] = 9;
+    }
+    for (; i < 280; i++) {
+        inflater->lengths[i] = 7;
+    }
+    for (; i < 288; i++) {
+        inflater->lengths[i] = 8;
+    }
+
+    inflater_build(inflater->length_count, inflater->length_symbol, inflater->lengths, 288);
+
+    memset(inflater->lengths, 5, 30);
+
+    inflater_build(inflater->distance_count, inflater->distance_symbol, inflater->lengths, 30);
+}
+
+static int inflater_dynamic_tables(inflater_t* inflater)
+{
+    if (inflater->lengths[256] == 0) {
+        LogError(("inflater_write: block has no end code"));
+        return -1;
+    }
+
+    int result = inflater_build(inflater->length_count, inflater->length_symbol, inflater->lengths, inflater->num_lengths);
+
+    if (result < 0 || (result > 0 && inflater->num_lengths - inflater->length_count[0] != 1)) {
+        LogError(("inflater_write: invalid literal/length code"));
+        return -1;
+    }
+
+    result = inflater_build(inflater->distance_count, inflater->distance_symbol, &inflater->lengths[inflater->num_lengths], inflater->num_distances);
+
+    if (result < 0 || (result > 0 && inflater->num_distances - inflater->distance_count[0] != 1)) {
+        LogError(("inflater_write: invalid distance code"));
+        return -1;
+    }
+
+    return 0;
+}
+
+// returns 1 after making progress, 0 if more input is needed or the stream is done
+static int inflater_step(inflater_t* inflater)
+{
+    int symbol;
+
+    switch (inflater->state) {
+        case INFLATER_STATE_HEADER:
+            if (inflater->final) {
+                inflater->state = INFLATER_STATE_DONE;
+                return 0;
+            }
+
+            if (!inflater_need(inflater, 3)) {
+                return 0;
+            }
+
+            inflater->final = inflater_take(inflater, 1);
+
+            switch (inflater_take(inflater, 2)) {
+                case 0:
+                    // stored blocks start on a byte boundary
+                    inflater_take(inflater, inflater->bit_count % 8);
+                    inflater->state = INFLATER_STATE_STORED_LEN;
+                    break;
+
+                case 1:
+                    inflater_fixed_tables(inflater);
+                    inflater->state = INFLATER_STATE_CODES;
+                    break;
+
+                case 2:
+                    inflater->state = INFLATER_STATE_TABLE_HEADER;
+                    break;
+
+                default:
+                    LogError(("inflater_write: invalid block type"));
+                    return -1;
+            }
+
+            return 1;
+
+        case INFLATER_STATE_STORED_LEN:
+            if (!inflater_need(inflater, 16)) {
+                return 0;
+            }
+
+            inflater->stored_len = inflater_take(inflater, 16);
+            inflater->state = INFLATER_STATE_STORED_NLEN;
+
+            return 1;
+
+        case INFLATER_STATE_STORED_NLEN:
+            if (!inflater_need(inflater, 16)) {
+                return 0;
+            }
+
+            if (inflater_take(inflater, 16) != (~inflater->stored_len & 0xFFFF)) {
+                LogError(("inflater_write: invalid stored block length"));
+                return -1;
+            }
+
+            inflater->state = INFLATER_STATE_STORED_COPY;
+
+            return 1;
+
+        case INFLATER_STATE_STORED_COPY:
+            // the bit buffer is empty here, as the lengths ended on a byte boundary
+            while (inflater->stored_len > 0) {
+                if (inflater->in_pos == inflater->in_len) {
+                    return 0;
+                }
+
+                if (inflater_put(inflater, inflater->in[inflater->in_pos++]) != 0) {
+                    return -1;
+                }
+
+                inflater->stored_len--;
+            }
+
+            inflater->state = INFLATER_STATE_HEADER;
+
+            return 1;
+
+        case INFLATER_STATE_TABLE_HEADER:
+            if (!inflater_need(inflater, 14)) {
+                return 0;
+            }
+
+            inflater->num_lengths = inflater_take(inflater, 5) + 257;
+            inflater->num_distances = inflater_take(inflater, 5) + 1;
+            inflater->num_code_lengths = inflater_take(inflater, 4) + 4;
+
+            if (inflater->num_lengths > 286 || inflater->num_distances > 30) {
+                LogError(("inflater_write: too many length or distance codes"));
+                return -1;
+            }
+
+            inflater->index = 0;
+            inflater->state = INFLATER_STATE_TABLE_CODE_LENGTHS;
+
+            return 1;
+
+        case INFLATER_STATE_TABLE_CODE_LENGTHS:
+            while (inflater->index < inflater->num_code_lengths) {
+                if (!inflater_need(inflater, 3)) {
+                    return 0;
+                }
+
+                inflater->lengths[code_length_order[inflater->index++]] = inflater_take(inflater, 3);
+            }
+
+            while (inflater->index < 19) {
+                inflater->lengths[code_length_order[inflater->index++]] = 0;
+            }
+
+            // the code length code is kept in the literal/length tables until those are read
+            if (inflater_build(inflater->length_count, inflater->length_symbol, inflater->lengths, 19) != 0) {
+                LogError(("inflater_write: invalid code length code"));
+                return -1;
+            }
+
+            inflater->index = 0;
+            inflater->state = INFLATER_STATE_TABLE_LENGTHS;
+
+            return 1;
+
+        case INFLATER_STATE_TABLE_LENGTHS:
+            while (inflater->index < inflater->num_lengths + inflater->num_distances) {
+                symbol = inflater_decode(inflater, inflater->length_count, inflater->length_symbol);
+
+                if (symbol == -1) {
+                    return 0;
+                } else if (symbol < 0) {
+                    LogError(("inflater_write: invalid code length"));
+                    return -1;
+                }
+
+                if (symbol < 16) {
+                    inflater->lengths[inflater->index++] = symbol;
+                } else {
+                    if (symbol == 16 && inflater->index == 0) {
+                        LogError(("inflater_write: repeat with no first length"));
+                        return -1;
+                    }
+
+                    inflater->symbol = symbol;
+                    inflater->state = INFLATER_STATE_TABLE_REPEAT;
+
+                    return 1;
+                }
+            }
+
+            if (inflater_dynamic_tables(inflater) != 0) {
+                return -1;
+            }
+
+            inflater->state = INFLATER_STATE_CODES;
+
+            return 1;
+
+        case INFLATER_STATE_TABLE_REPEAT: {
+            uint8_t len = 0;
+            unsigned int repeat;
+
+            if (inflater->symbol == 16) {
+                if (!inflater_need(inflater, 2)) {
+                    return 0;
+                }
+
+                len = inflater->lengths[inflater->index - 1];
+                repeat = 3 + inflater_take(inflater, 2);
+            } else if (inflater->symbol == 17) {
+                if (!inflater_need(inflater, 3)) {
+                    return 0;
+                }
+
+                repeat = 3 + inflater_take(inflater, 3);
+            } else {
+                if (!inflater_need(inflater, 7)) {
+                    return 0;
+                }
+
+                repeat = 11 + inflater_take(inflater, 7);
+            }
+
+            if (inflater->index + repeat > inflater->num_lengths + inflater->num_distances) {
+                LogError(("inflater_write: too many code lengths"));
+                return -1;
+            }
+
+            while (repeat--) {
+                inflater->lengths[inflater->index++] = len;
+            }
+
+            inflater->state = INFLATER_STATE_TABLE_LENGTHS;
+
+            return 1;
+        }
+
+        case INFLATER_STATE_CODES:
+            while (1) {
+                symbol = inflater_decode(inflater, inflater->length_count, inflater->length_symbol);
+
+                if (symbol == -1) {
+                    return 0;
+                } else if (symbol < 0) {
+                    LogError(("inflater_write: invalid literal/length code"));
+                    return -1;
+                }
+
+                if (symbol < 256) {
+                    if (inflater_put(inflater, symbol) != 0) {
+                        return -1;
+                    }
+
+                    continue;
+                }
+
+                if (symbol == 256) {
+                    inflater->state = INFLATER_STATE_HEADER;
+                    return 1;
+                }
+
+                symbol -= 257;
+
+                if (symbol >= 29) {
+                    LogError(("inflater_write: invalid length code"));
+                    return -1;
+                }
+
+                inflater->symbol = symbol;
+                inflater->state = INFLATER_STATE_LENGTH_EXTRA;
+
+                return 1;
+            }
+
+        case INFLATER_STATE_LENGTH_EXTRA:
+            if (!inflater_need(inflater, length_extra[inflater->symbol])) {
+                return 0;
+            }
+
+            inflater->match_len = length_base[inflater->symbol] + inflater_take(inflater, length_extra[inflater->symbol]);
+            inflater->state = INFLATER_STATE_DISTANCE;
+
+            return 1;
+
+        case INFLATER_STATE_DISTANCE:
+            symbol = inflater_decode(inflater, inflater->distance_count, inflater->distance_symbol);
+
+            if (symbol == -1) {
+                return 0;
+            } else if (symbol < 0) {
+                LogError(("inflater_write: invalid distance code"));
+                return -1;
+            }
+
+            inflater->symbol = symbol;
+            inflater->state = INFLATER_STATE_DISTANCE_EXTRA;
+
+            return 1;
+
+        case INFLATER_STATE_DISTANCE_EXTRA:
+            if (!inflater_need(inflater, distance_extra[inflater->symbol])) {
+                return 0;
+            }
+
+            if (inflater_copy(inflater, distance_base[inflater->symbol] + inflater_take(inflater, distance_extra[inflater->symbol]), inflater->match_len) != 0) {
+                return -1;
+            }
+
+            inflater->state = INFLATER_STATE_CODES;
+
+            return 1;
+
+        case INFLATER_STATE_DONE:
+            return 0;
+
+        default:
+            return -1;
+    }
+}
+
+int inflater_write(inflater_t* inflater, const uint8_t* data, size_t len)
+{
+    if (inflater->state == INFLATER_STATE_ERROR) {
+        return -1;
+    }
+
+    inflater->in = data;
+    inflater->in_len = len;
+    inflater->in_pos = 0;
+
+    int result;
+
+    while ((result = inflater_step(inflater)) > 0) {
+    }
+
+    if (result < 0 || inflater_flush(inflater) != 0) {
+        inflater->state = INFLATER_STATE_ERROR;
+        return -1;
+    }
+
+    return inflater->in_pos;
+}
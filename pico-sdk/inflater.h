@@ -0,0 +1,83 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+
+#ifndef __INFLATER_H__
+#define __INFLATER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// receives inflated data, returning non-zero stops inflating
+typedef int (*inflater_output_t)(void* arg, const uint8_t* data, size_t len);
+
+typedef enum {
+    INFLATER_STATE_HEADER,
+    INFLATER_STATE_STORED_LEN,
+    INFLATER_STATE_STORED_NLEN,
+    INFLATER_STATE_STORED_COPY,
+    INFLATER_STATE_TABLE_HEADER,
+    INFLATER_STATE_TABLE_CODE_LENGTHS,
+    INFLATER_STATE_TABLE_LENGTHS,
+    INFLATER_STATE_TABLE_REPEAT,
+    INFLATER_STATE_CODES,
+    INFLATER_STATE_LENGTH_EXTRA,
+    INFLATER_STATE_DISTANCE,
+    INFLATER_STATE_DISTANCE_EXTRA,
+    INFLATER_STATE_DONE,
+    INFLATER_STATE_ERROR
+} inflater_state_t;
+
+// streaming raw DEFLATE (RFC 1951) decoder, the input can be split anywhere
+typedef struct {
+    inflater_state_t state;
+    int final;
+
+    uint32_t bits;
+    unsigned int bit_count;
+
+    // input of the current inflater_write call
+    const uint8_t* in;
+    size_t in_len;
+    size_t in_pos;
+
+    // the last window_size bytes of output, for matches to copy from
+    uint8_t* window;
+    size_t window_size;
+    size_t window_pos;
+    size_t window_have;
+    size_t flush_pos;
+
+    // current block
+    size_t stored_len;
+    unsigned int num_lengths;
+    unsigned int num_distances;
+    unsigned int num_code_lengths;
+    unsigned int index;
+    unsigned int symbol;
+    unsigned int match_len;
+
+    uint8_t lengths[286 + 30];
+    uint16_t length_count[16];
+    uint16_t length_symbol[288];
+    uint16_t distance_count[16];
+    uint16_t distance_symbol[30];
+
+    inflater_output_t output;
+    void* output_arg;
+} inflater_t;
+
+// window needs 2^window_bits bytes, the largest match distance the data may use
+void inflater_init(inflater_t* inflater, uint8_t* window, unsigned int window_bits, inflater_output_t output, void* arg);
+
+// starts a new stream, forgetting the window
+void inflater_reset(inflater_t* inflater);
+
+// returns how many bytes were used, less than len only once the final block is done, or -1 on error
+int inflater_write(inflater_t* inflater, const uint8_t* data, size_t len);
+
+int inflater_finished(inflater_t* inflater);
+
+#endif
@@ -0,0 +1,386 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+#include <string.h>
+
+#include "json_scanner.h"
+
+void json_scanner_init(json_scanner_t* scanner, json_scanner_field_t* fields, size_t num_fields)
+{
+    scanner->fields = fields;
+    scanner->num_fields = num_fields;
+
+    scanner->state = JSON_SCANNER_STATE_VALUE;
+    scanner->stack = 0;
+    scanner->depth = 0;
+    scanner->high_surrogate = 0;
+    scanner->field = NULL;
+
+    for (size_t i = 0; i < num_fields; i++) {
+        fields[i].found = 0;
+        fields[i].truncated = 0;
+        fields[i].complete = 0;
+
+        if (fields[i].value_len > 0) {
+            fields[i].value[0] = '\0';
+        }
+    }
+}
+
+int json_scanner_done(json_scanner_t* scanner)
+{
+    return (scanner->state == JSON_SCANNER_STATE_DONE);
+}
+
+static int json_scanner_is_space(char c)
+{
+    return (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+}
+
+static int json_scanner_hex(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+static void json_scanner_put(json_scanner_t* scanner, char c)
+{
+    if (scanner->string_is_key) {
+        if (scanner->key_len < sizeof(scanner->key) - 1) {
+            scanner->key[scanner->key_len++] = c;
+        } else {
+            scanner->key_truncated = 1;
+        }
+    } else if (scanner->field != NULL) {
+        if (scanner->field_len + 1 < scanner->field->value_len) {
+            scanner->field->value[scanner->field_len++] = c;
+            scanner->field->value[scanner->field_len] = '\0';
+        } else {
+            scanner->field->truncated = 1;
+        }
+    }
+}
+
+static void json_scanner_put_unicode(json_scanner_t* scanner, uint32_t c)
+{
+    if (c < 0x80) {
+        json_scanner_put(scanner, c);
+    } else if (c < 0x800) {
+        json_scanner_put(scanner, 0xC0 | (c >> 6));
+        json_scanner_put(scanner, 0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        json_scanner_put(scanner, 0xE0 | (c >> 12));
+        json_scanner_put(scanner, 0x80 | ((c >> 6) & 0x3F));
+        json_scanner_put(scanner, 0x80 | (c & 0x3F));
+    } else {
+        json_scanner_put(scanner, 0xF0 | (c >> 18));
+        json_scanner_put(scanner, 0x80 | ((c >> 12) & 0x3F));
+        json_scanner_put(scanner, 0x80 | ((c >> 6) & 0x3F));
+        json_scanner_put(scanner, 0x80 | (c & 0x3F));
+    }
+}
+
+// code units outside the BMP come as a high and a low surrogate, which
+// together make one 4-byte UTF-8 sequence, an unpaired one is an error
+static int json_scanner_end_unicode(json_scanner_t* scanner)
+{
+    uint32_t c = scanner->unicode;
+
+    if (c >= 0xD800 && c <= 0xDBFF) {
+        if (scanner->high_surrogate != 0) {
+            return -1;
+        }
+
+        scanner->high_surrogate = c;
+        return 0;
+    }
+
+    if (c >= 0xDC00 && c <= 0xDFFF) {
+        if (scanner->high_surrogate == 0) {
+            return -1;
+        }
+
+        c = 0x10000 + ((scanner->high_surrogate - 0xD800) << 10) + (c - 0xDC00);
+        scanner->high_surrogate = 0;
+    } else if (scanner->high_surrogate != 0) {
+        return -1;
+    }
+
+    json_scanner_put_unicode(scanner, c);
+
+    return 0;
+}
+
+// picks the field the value of the key that just ended is copied to
+static void json_scanner_end_key(json_scanner_t* scanner)
+{
+    scanner->field = NULL;
+
+    if (scanner->depth != 1 || scanner->key_truncated) {
+        return;
+    }
+
+    scanner->key[scanner->key_len] = '\0';
+
+    for (size_t i = 0; i < scanner->num_fields; i++) {
+        if (strcmp(scanner->key, scanner->fields[i].key) == 0) {
+            scanner->field = &scanner->fields[i];
+            break;
+        }
+    }
+}
+
+static void json_scanner_start_value(json_scanner_t* scanner, int scalar)
+{
+    if (scanner->field == NULL) {
+        return;
+    }
+
+    scanner->field->found = 1;
+    scanner->field->truncated = 0;
+    scanner->field->complete = 0;
+    scanner->field_len = 0;
+
+    if (scanner->field->value_len > 0) {
+        scanner->field->value[0] = '\0';
+    }
+
+    // only scalars are copied
+    if (!scalar) {
+        scanner->field = NULL;
+    }
+}
+
+static void json_scanner_end_value(json_scanner_t* scanner)
+{
+    if (scanner->depth == 0) {
+        scanner->state = JSON_SCANNER_STATE_DONE;
+        return;
+    }
+
+    if (scanner->depth == 1 && scanner->field != NULL) {
+        scanner->field->complete = 1;
+        scanner->field = NULL;
+    }
+
+    scanner->state = JSON_SCANNER_STATE_AFTER_VALUE;
+}
+
+static int json_scanner_push(json_scanner_t* scanner, int object)
+{
+    if (scanner->depth == 32) {
+        return -1;
+    }
+
+    json_scanner_start_value(scanner, 0);
+
+    scanner->stack = (scanner->stack << 1) | (object ? 1 : 0);
+    scanner->depth++;
+    scanner->state = object ? JSON_SCANNER_STATE_KEY : JSON_SCANNER_STATE_VALUE;
+
+    return 0;
+}
+
+static int json_scanner_pop(json_scanner_t* scanner, int object)
+{
+    if (scanner->depth == 0 || (scanner->stack & 1) != (object ? 1 : 0)) {
+        return -1;
+    }
+
+    scanner->stack >>= 1;
+    scanner->depth--;
+
+    json_scanner_end_value(scanner);
+
+    return 0;
+}
+
+static int json_scanner_step(json_scanner_t* scanner, char c)
+{
+    int digit;
+
+    while (1) {
+        switch (scanner->state) {
+            case JSON_SCANNER_STATE_VALUE:
+                if (json_scanner_is_space(c)) {
+                    return 0;
+                } else if (c == '{') {
+                    return json_scanner_push(scanner, 1);
+                } else if (c == '[') {
+                    return json_scanner_push(scanner, 0);
+                } else if (c == ']') {
+                    // empty array
+                    return json_scanner_pop(scanner, 0);
+                } else if (c == '"') {
+                    json_scanner_start_value(scanner, 1);
+                    scanner->string_is_key = 0;
+                    scanner->state = JSON_SCANNER_STATE_STRING;
+                    return 0;
+                } else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+                    json_scanner_start_value(scanner, 1);
+                    scanner->string_is_key = 0;
+                    json_scanner_put(scanner, c);
+                    scanner->state = JSON_SCANNER_STATE_LITERAL;
+                    return 0;
+                }
+
+                return -1;
+
+            case JSON_SCANNER_STATE_KEY:
+                if (json_scanner_is_space(c)) {
+                    return 0;
+                } else if (c == '"') {
+                    scanner->key_len = 0;
+                    scanner->key_truncated = 0;
+                    scanner->string_is_key = 1;
+                    scanner->state = JSON_SCANNER_STATE_STRING;
+                    return 0;
+                } else if (c == '}') {
+                    // empty object
+                    return json_scanner_pop(scanner, 1);
+                }
+
+                return -1;
+
+            case JSON_SCANNER_STATE_COLON:
+                if (json_scanner_is_space(c)) {
+                    return 0;
+                } else if (c == ':') {
+                    scanner->state = JSON_SCANNER_STATE_VALUE;
+                    return 0;
+                }
+
+                return -1;
+
+            case JSON_SCANNER_STATE_AFTER_VALUE:
+                if (json_scanner_is_space(c)) {
+                    return 0;
+                } else if (c == ',') {
+                    scanner->state = (scanner->stack & 1) ? JSON_SCANNER_STATE_KEY : JSON_SCANNER_STATE_VALUE;
+                    return 0;
+                } else if (c == '}') {
+                    return json_scanner_pop(scanner, 1);
+                } else if (c == ']') {
+                    return json_scanner_pop(scanner, 0);
+                }
+
+                return -1;
+
+            case JSON_SCANNER_STATE_STRING:
+                // a high surrogate has to be followed by the escaped low one
+                if (scanner->high_surrogate != 0 && c != '\\') {
+                    return -1;
+                }
+
+                if (c == '"') {
+                    if (scanner->string_is_key) {
+                        scanner->string_is_key = 0;
+                        json_scanner_end_key(scanner);
+                        scanner->state = JSON_SCANNER_STATE_COLON;
+                    } else {
+                        json_scanner_end_value(scanner);
+                    }
+
+                    return 0;
+                } else if (c == '\\') {
+                    scanner->state = JSON_SCANNER_STATE_STRING_ESCAPE;
+                    return 0;
+                } else if ((uint8_t)c < 0x20) {
+                    return -1;
+                }
+
+                json_scanner_put(scanner, c);
+                return 0;
+
+            case JSON_SCANNER_STATE_STRING_ESCAPE:
+                scanner->state = JSON_SCANNER_STATE_STRING;
+
+                if (scanner->high_surrogate != 0 && c != 'u') {
+                    return -1;
+                }
+
+                switch (c) {
+                    case '"':
+                    case '\\':
+                    case '/':
+                        json_scanner_put(scanner, c);
+                        return 0;
+                    case 'b':
+                        json_scanner_put(scanner, '\b');
+                        return 0;
+                    case 'f':
+                        json_scanner_put(scanner, '\f');
+                        return 0;
+                    case 'n':
+                        json_scanner_put(scanner, '\n');
+                        return 0;
+                    case 'r':
+                        json_scanner_put(scanner, '\r');
+                        return 0;
+                    case 't':
+                        json_scanner_put(scanner, '\t');
+                        return 0;
+                    case 'u':
+                        scanner->unicode = 0;
+                        scanner->unicode_digits = 0;
+                        scanner->state = JSON_SCANNER_STATE_STRING_UNICODE;
+                        return 0;
+                }
+
+                return -1;
+
+            case JSON_SCANNER_STATE_STRING_UNICODE:
+                digit = json_scanner_hex(c);
+
+                if (digit < 0) {
+                    return -1;
+                }
+
+                scanner->unicode = (scanner->unicode << 4) | digit;
+
+                if (++scanner->unicode_digits == 4) {
+                    scanner->state = JSON_SCANNER_STATE_STRING;
+                    return json_scanner_end_unicode(scanner);
+                }
+
+                return 0;
+
+            case JSON_SCANNER_STATE_LITERAL:
+                if (c == '-' || c == '+' || c == '.' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+                    json_scanner_put(scanner, c);
+                    return 0;
+                }
+
+                // the literal ended with c, which is looked at again after it
+                json_scanner_end_value(scanner);
+                continue;
+
+            case JSON_SCANNER_STATE_DONE:
+                return json_scanner_is_space(c) ? 0 : -1;
+
+            default:
+                return -1;
+        }
+    }
+}
+
+int json_scanner_feed(json_scanner_t* scanner, const uint8_t* data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (json_scanner_step(scanner, data[i]) != 0) {
+            scanner->state = JSON_SCANNER_STATE_ERROR;
+            return -1;
+        }
+    }
+
+    return 0;
+}
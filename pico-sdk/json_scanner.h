@@ -0,0 +1,75 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+
+#ifndef __JSON_SCANNER_H__
+#define __JSON_SCANNER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef JSON_SCANNER_KEY_MAX_LEN
+#define JSON_SCANNER_KEY_MAX_LEN 32
+#endif
+
+// a top-level field to pick out, strings are unescaped and other
+// scalars are copied as written, e.g. "true" or "42"
+typedef struct {
+    const char* key;
+    char* value;
+    size_t value_len;
+    int found;
+    int truncated;
+    // set once the whole value was seen, for documents fed in pieces
+    int complete;
+} json_scanner_field_t;
+
+typedef enum {
+    JSON_SCANNER_STATE_VALUE,
+    JSON_SCANNER_STATE_KEY,
+    JSON_SCANNER_STATE_COLON,
+    JSON_SCANNER_STATE_AFTER_VALUE,
+    JSON_SCANNER_STATE_STRING,
+    JSON_SCANNER_STATE_STRING_ESCAPE,
+    JSON_SCANNER_STATE_STRING_UNICODE,
+    JSON_SCANNER_STATE_LITERAL,
+    JSON_SCANNER_STATE_DONE,
+    JSON_SCANNER_STATE_ERROR
+} json_scanner_state_t;
+
+// picks fields out of a JSON document fed in pieces, without building a tree
+typedef struct {
+    json_scanner_field_t* fields;
+    size_t num_fields;
+
+    json_scanner_state_t state;
+    // one bit per open container, set for objects
+    uint32_t stack;
+    unsigned int depth;
+
+    int string_is_key;
+    uint32_t unicode;
+    unsigned int unicode_digits;
+    // first half of a \uD83D\uDE00 style surrogate pair, 0 if none is pending
+    uint32_t high_surrogate;
+
+    char key[JSON_SCANNER_KEY_MAX_LEN];
+    size_t key_len;
+    int key_truncated;
+
+    // field the current value is copied to, if any
+    json_scanner_field_t* field;
+    size_t field_len;
+} json_scanner_t;
+
+void json_scanner_init(json_scanner_t* scanner, json_scanner_field_t* fields, size_t num_fields);
+
+// returns -1 once the input turned out not to be JSON
+int json_scanner_feed(json_scanner_t* scanner, const uint8_t* data, size_t len);
+
+// set once the top-level value is complete
+int json_scanner_done(json_scanner_t* scanner);
+
+#endif
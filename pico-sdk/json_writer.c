@@ -0,0 +1,159 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+#include <stdint.h>
+#include <string.h>
+
+#include "json_writer.h"
+
+void json_writer_init(json_writer_t* writer, char* buf, size_t len)
+{
+    writer->buf = buf;
+    writer->len = len;
+    writer->pos = 0;
+    writer->need_comma = 0;
+    // one byte is kept for the terminating NUL
+    writer->overflow = (len == 0);
+}
+
+static void json_writer_put(json_writer_t* writer, const char* data, size_t len)
+{
+    if (writer->overflow || len > writer->len - writer->pos - 1) {
+        writer->overflow = 1;
+        return;
+    }
+
+    memcpy(&writer->buf[writer->pos], data, len);
+    writer->pos += len;
+}
+
+static void json_writer_put_char(json_writer_t* writer, char c)
+{
+    json_writer_put(writer, &c, 1);
+}
+
+// values after the first in an object or array are separated by a comma
+static void json_writer_separate(json_writer_t* writer)
+{
+    if (writer->need_comma) {
+        json_writer_put_char(writer, ',');
+    }
+}
+
+void json_writer_begin_object(json_writer_t* writer)
+{
+    json_writer_separate(writer);
+    json_writer_put_char(writer, '{');
+    writer->need_comma = 0;
+}
+
+void json_writer_end_object(json_writer_t* writer)
+{
+    json_writer_put_char(writer, '}');
+    writer->need_comma = 1;
+}
+
+void json_writer_begin_array(json_writer_t* writer)
+{
+    json_writer_separate(writer);
+    json_writer_put_char(writer, '[');
+    writer->need_comma = 0;
+}
+
+void json_writer_end_array(json_writer_t* writer)
+{
+    json_writer_put_char(writer, ']');
+    writer->need_comma = 1;
+}
+
+// string with quotes, escaped the way cJSON_PrintUnformatted does it
+static void json_writer_put_string(json_writer_t* writer, const char* value)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char* run = value;
+    const char* p;
+
+    json_writer_put_char(writer, '"');
+
+    for (p = value; *p != '\0'; p++) {
+        uint8_t c = *p;
+
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        // characters up to here need no escaping and are copied at once
+        json_writer_put(writer, run, p - run);
+        run = p + 1;
+
+        switch (c) {
+            case '"':
+                json_writer_put(writer, "\\\"", 2);
+                break;
+            case '\\':
+                json_writer_put(writer, "\\\\", 2);
+                break;
+            case '\b':
+                json_writer_put(writer, "\\b", 2);
+                break;
+            case '\f':
+                json_writer_put(writer, "\\f", 2);
+                break;
+            case '\n':
+                json_writer_put(writer, "\\n", 2);
+                break;
+            case '\r':
+                json_writer_put(writer, "\\r", 2);
+                break;
+            case '\t':
+                json_writer_put(writer, "\\t", 2);
+                break;
+            default: {
+                char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+
+                json_writer_put(writer, escape, sizeof(escape));
+                break;
+            }
+        }
+    }
+
+    json_writer_put(writer, run, p - run);
+    json_writer_put_char(writer, '"');
+}
+
+void json_writer_key(json_writer_t* writer, const char* key)
+{
+    json_writer_separate(writer);
+    json_writer_put_string(writer, key);
+    json_writer_put_char(writer, ':');
+    writer->need_comma = 0;
+}
+
+void json_writer_string(json_writer_t* writer, const char* value)
+{
+    json_writer_separate(writer);
+    json_writer_put_string(writer, value);
+    writer->need_comma = 1;
+}
+
+// a value that is already serialized, e.g. with cJSON
+void json_writer_raw(json_writer_t* writer, const char* json)
+{
+    json_writer_separate(writer);
+    json_writer_put(writer, json, strlen(json));
+    writer->need_comma = 1;
+}
+
+// terminates the JSON with a NUL, returns its length or -1 if it did not fit
+int json_writer_finish(json_writer_t* writer)
+{
+    if (writer->overflow) {
+        return -1;
+    }
+
+    writer->buf[writer->pos] = '\0';
+
+    return writer->pos;
+}
@@ -0,0 +1,40 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+
+#ifndef __JSON_WRITER_H__
+#define __JSON_WRITER_H__
+
+#include <stddef.h>
+
+// writes compact JSON into a caller's buffer without allocating, a value that
+// does not fit marks the writer as overflowed and json_writer_finish fails
+typedef struct {
+    char* buf;
+    size_t len;
+    size_t pos;
+    int need_comma;
+    int overflow;
+} json_writer_t;
+
+void json_writer_init(json_writer_t* writer, char* buf, size_t len);
+
+void json_writer_begin_object(json_writer_t* writer);
+
+void json_writer_end_object(json_writer_t* writer);
+
+void json_writer_begin_array(json_writer_t* writer);
+
+void json_writer_end_array(json_writer_t* writer);
+
+void json_writer_key(json_writer_t* writer, const char* key);
+
+void json_writer_string(json_writer_t* writer, const char* value);
+
+void json_writer_raw(json_writer_t* writer, const char* json);
+
+int json_writer_finish(json_writer_t* writer);
+
+#endif
@@ -12,15 +12,35 @@
 #include "pico/cyw43_arch.h"
 #include "pico/stdlib.h"
 
+#include "ISRG_Root_X1.h"
+#include "buf_pool.h"
 #include "logging.h"
 #include "slack_client.h"
+#include "tls_arena.h"
 
 extern char *strcasestr(const char *haystack, const char *needle);
 
 void main_task(void*);
 void handle_event(cJSON* event_json);
-
-char buf[2048];
+void handle_post_message_sent(void* arg, int result);
+int upload_report(const char* channel);
+
+// posted in one burst in reply to "help"
+static const char* help_texts[] = {
+    "`led on` turns the LED on",
+    "`led off` turns the LED off",
+    "`report` uploads the memory and send statistics as a file",
+    "`help` lists these commands"
+};
+
+// file body handed out piece by piece to slack_client_upload_file
+typedef struct {
+    char text[512];
+    size_t len;
+    size_t sent;
+} report_t;
+
+tls_config_t tls_config;
 slack_client_t slack_client;
 
 int main(void)
@@ -54,11 +74,30 @@ void main_task(void*)
         LogInfo(("Connected to Wi-Fi SSID '%s'", WIFI_SSID));
     }
 
-    if (slack_client_init(&slack_client, SLACK_BOT_TOKEN, SLACK_APP_TOKEN, buf, sizeof(buf)) != 0) {
+    if (tls_arena_init() != 0) {
+        LogError(("Failed to initialize TLS memory arena!"));
+        while(true) { vTaskDelay(100); }
+    }
+
+    if (buf_pool_init() != 0) {
+        LogError(("Failed to initialize buffer pool!"));
+        while(true) { vTaskDelay(100); }
+    }
+
+    if (tls_config_init(&tls_config, ISRG_Root_X1_der, sizeof(ISRG_Root_X1_der)) != 0) {
+        LogError(("Failed to initialize TLS configuration!"));
+        while(true) { vTaskDelay(100); }
+    }
+
+    if (slack_client_init(&slack_client, &tls_config, SLACK_BOT_TOKEN, SLACK_APP_TOKEN) != 0) {
         LogError(("Failed to initialize Slack client!"));
         while(true) { vTaskDelay(100); }    
     }
 
+    // events_api envelopes are acknowledged as soon as they arrive, handle_event's
+    // slack_client_acknowledge_event call then does nothing
+    slack_client_set_ack_first(&slack_client, 1);
+
     while (1) {
         cJSON* event_json = slack_client_poll(&slack_client);
         if (event_json == NULL) {
@@ -103,6 +142,8 @@ void handle_event(cJSON* event_json)
             const char* payload_event_type = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(payload_event_json, "type"));
             const char* payload_event_channel = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(payload_event_json, "channel"));
             const char* post_message_text = NULL;
+            int post_help = 0;
+            int post_report = 0;
             
             LogInfo(("\t\tpayload_event_type = %s", payload_event_type));
             LogInfo(("\t\tpayload_event_channel = %s", payload_event_channel));
@@ -120,6 +161,10 @@ void handle_event(cJSON* event_json)
                     cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 0);
 
                     post_message_text = "LED is now off";
+                } else if (strcasestr(text, "help") != NULL) {
+                    post_help = 1;
+                } else if (strcasestr(text, "report") != NULL) {
+                    post_report = 1;
                 }
             }
 
@@ -127,8 +172,82 @@ void handle_event(cJSON* event_json)
 
             if (post_message_text != NULL) {
                 LogInfo(("Posting message '%s' to channel = '%s'", post_message_text, payload_event_channel));
-                slack_client_post_message(&slack_client, post_message_text, payload_event_channel);
+                slack_client_post_message_async(&slack_client, post_message_text, payload_event_channel, handle_post_message_sent, NULL);
+            }
+
+            if (post_help) {
+                // pipelined on one connection, events wait until the burst is answered
+                LogInfo(("Posting help to channel = '%s'", payload_event_channel));
+                if (slack_client_post_messages(&slack_client, help_texts, sizeof(help_texts) / sizeof(help_texts[0]), payload_event_channel) != 0) {
+                    LogError(("Failed to post help!"));
+                }
+            }
+
+            if (post_report) {
+                LogInfo(("Uploading report to channel = '%s'", payload_event_channel));
+                if (upload_report(payload_event_channel) != 0) {
+                    LogError(("Failed to upload report!"));
+                }
             }
         }
     }
 }
+
+// runs on the Slack client's sender task
+void handle_post_message_sent(void* arg, int result)
+{
+    if (result != 0) {
+        LogError(("Failed to post message!"));
+    } else {
+        LogInfo(("Posted message"));
+    }
+}
+
+static int produce_report(void* arg, uint8_t* buf, size_t len)
+{
+    report_t* report = (report_t*)arg;
+    size_t left = report->len - report->sent;
+
+    if (len > left) {
+        len = left;
+    }
+
+    memcpy(buf, &report->text[report->sent], len);
+    report->sent += len;
+
+    return len;
+}
+
+// streamed from the producer, events wait until the upload is done
+int upload_report(const char* channel)
+{
+    static report_t report;
+    tls_arena_stats_t arena_stats;
+    buf_pool_stats_t buf_stats;
+    slack_client_send_stats_t send_stats;
+
+    tls_arena_get_stats(&arena_stats);
+    buf_pool_get_stats(&buf_stats);
+    slack_client_get_send_stats(&slack_client, &send_stats);
+
+    int len = snprintf(
+        report.text,
+        sizeof(report.text),
+        "TLS arena: used = %u, peak = %u, size = %u, failed = %u\n"
+        "Buffer pool: in use = %u, peak = %u, buffers = %u, failed = %u\n"
+        "Messages: sent = %u, failed = %u, throttled = %u, delayed = %u, max delay = %u ms\n",
+        (unsigned int)arena_stats.used, (unsigned int)arena_stats.peak, (unsigned int)arena_stats.size, (unsigned int)arena_stats.failed,
+        (unsigned int)buf_stats.in_use, (unsigned int)buf_stats.peak, (unsigned int)buf_stats.num_bufs, (unsigned int)buf_stats.failed,
+        (unsigned int)send_stats.sent, (unsigned int)send_stats.failed, (unsigned int)send_stats.throttled, (unsigned int)send_stats.delayed, (unsigned int)send_stats.max_delay_ms
+    );
+
+    if (len < 0 || (size_t)len >= sizeof(report.text)) {
+        LogError(("upload_report: report is too long!"));
+        return -1;
+    }
+
+    report.len = len;
+    report.sent = 0;
+
+    return slack_client_upload_file(&slack_client, channel, "report.txt", report.len, produce_report, &report);
+}
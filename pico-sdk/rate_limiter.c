@@ -0,0 +1,88 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "rate_limiter.h"
+
+void rate_limiter_init(rate_limiter_t* limiter, uint32_t per_minute, uint32_t burst)
+{
+    limiter->per_minute = per_minute;
+    limiter->burst = burst;
+    limiter->tokens = burst * 1000;
+    limiter->updated = xTaskGetTickCount();
+    limiter->blocked = 0;
+    limiter->blocked_until = 0;
+}
+
+static void rate_limiter_refill(rate_limiter_t* limiter, TickType_t now)
+{
+    // the bucket stays empty while blocked and refills from the end of the block
+    if (limiter->blocked) {
+        if ((int32_t)(limiter->blocked_until - now) > 0) {
+            limiter->updated = now;
+            return;
+        }
+
+        limiter->blocked = 0;
+        limiter->updated = limiter->blocked_until;
+    }
+
+    uint64_t elapsed_ms = (uint64_t)(now - limiter->updated) * portTICK_PERIOD_MS;
+    uint64_t tokens = limiter->tokens + elapsed_ms * limiter->per_minute / 60;
+
+    limiter->tokens = (tokens > limiter->burst * 1000) ? limiter->burst * 1000 : tokens;
+    limiter->updated = now;
+}
+
+// ticks until a token can be taken, 0 if one is available now
+TickType_t rate_limiter_delay(rate_limiter_t* limiter)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    rate_limiter_refill(limiter, now);
+
+    if (limiter->blocked) {
+        return limiter->blocked_until - now;
+    }
+
+    if (limiter->tokens >= 1000 || limiter->per_minute == 0) {
+        return 0;
+    }
+
+    // round up, so the token is there when the delay is over
+    uint32_t ms = ((1000 - limiter->tokens) * 60 + limiter->per_minute - 1) / limiter->per_minute;
+
+    return pdMS_TO_TICKS(ms) + 1;
+}
+
+void rate_limiter_take(rate_limiter_t* limiter)
+{
+    rate_limiter_refill(limiter, xTaskGetTickCount());
+
+    limiter->tokens = (limiter->tokens >= 1000) ? limiter->tokens - 1000 : 0;
+}
+
+// empties the bucket and holds it empty for seconds
+void rate_limiter_block(rate_limiter_t* limiter, uint32_t seconds)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    rate_limiter_refill(limiter, now);
+
+    limiter->tokens = 0;
+    limiter->blocked = 1;
+    limiter->blocked_until = now + pdMS_TO_TICKS(seconds * 1000);
+}
+
+// a full bucket that is not blocked, it is no different from a new one
+int rate_limiter_idle(rate_limiter_t* limiter)
+{
+    rate_limiter_refill(limiter, xTaskGetTickCount());
+
+    return !limiter->blocked && limiter->tokens == limiter->burst * 1000;
+}
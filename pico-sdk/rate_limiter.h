@@ -0,0 +1,36 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+
+#ifndef __RATE_LIMITER_H__
+#define __RATE_LIMITER_H__
+
+#include <stdint.h>
+
+#include <FreeRTOS.h>
+
+// token bucket, refilled with per_minute tokens a minute up to burst tokens
+typedef struct {
+    uint32_t per_minute;
+    uint32_t burst;
+    uint32_t tokens; // in thousandths of a token
+    TickType_t updated;
+
+    // set after the server asked to back off with Retry-After
+    int blocked;
+    TickType_t blocked_until;
+} rate_limiter_t;
+
+void rate_limiter_init(rate_limiter_t* limiter, uint32_t per_minute, uint32_t burst);
+
+TickType_t rate_limiter_delay(rate_limiter_t* limiter);
+
+void rate_limiter_take(rate_limiter_t* limiter);
+
+void rate_limiter_block(rate_limiter_t* limiter, uint32_t seconds);
+
+int rate_limiter_idle(rate_limiter_t* limiter);
+
+#endif
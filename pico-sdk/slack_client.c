@@ -5,164 +5,546 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-#include "ISRG_Root_X1.h"
+#include "buf_pool.h"
+#include "dns_cache.h"
+#include "json_writer.h"
 #include "logging.h"
 
 #include "slack_client.h"
+#include "tls_arena.h"
 
-int slack_client_init(slack_client_t* client, const char* bot_token, const char* app_token, char* buf, size_t buf_len)
+// events that do not fit in the receive buffer cannot be handled, but they
+// still have to be acknowledged or Slack keeps sending them again
+static int slack_client_consume_large_message(void* arg, uint8_t type, const uint8_t* data, size_t len, uint64_t offset, int last)
 {
-    client->bot_token = bot_token;
-    client->app_token = app_token;
-    client->buf = buf,
-    client->buf_len = buf_len;
+    slack_client_t* client = (slack_client_t*)arg;
+    json_scanner_field_t* field = &client->large_envelope_id;
+
+    if (offset == 0) {
+        field->key = "envelope_id";
+        field->value = client->large_envelope_id_value;
+        field->value_len = sizeof(client->large_envelope_id_value);
+
+        json_scanner_init(&client->large_message, field, 1);
+        client->large_acked = 0;
+    }
+
+    // envelope_id can be anywhere in the envelope, so every chunk is scanned until it is complete
+    if (!client->large_acked && json_scanner_feed(&client->large_message, data, len) == 0 && field->complete && !field->truncated) {
+        LogWarn(("slack_client_consume_large_message: dropping large event, envelope_id = %s", field->value));
+
+        slack_client_acknowledge_event(client, field->value, NULL);
+        client->large_acked = 1;
+    }
+
+    if (last && !client->large_acked) {
+        LogWarn(("slack_client_consume_large_message: dropping large message without envelope_id"));
+    }
 
     return 0;
 }
 
-int slack_client_open_app_connection(slack_client_t* client)
+// Web API responses are scanned as they arrive, only the fields asked for are kept
+static int slack_client_consume_response(void* arg, const uint8_t* data, size_t len)
 {
-    if (https_client_init(&client->https, ISRG_Root_X1_der, sizeof(ISRG_Root_X1_der), client->buf, client->buf_len) != 0) {
-        LogError(("slack_client_open_app_connection: https_client_init failed!"));
+    json_scanner_t* scanner = (json_scanner_t*)arg;
+
+    // a malformed body is reported after the request, the rest of it is still read
+    json_scanner_feed(scanner, data, len);
+
+    return 0;
+}
+
+static void slack_client_log_gzip_stats(slack_client_t* client, const char* func)
+{
+    https_gzip_stats_t gzip_stats;
+    https_client_get_gzip_stats(&client->https, &gzip_stats);
+
+    if (gzip_stats.inflated_bytes > 0) {
+        LogDebug((
+            "%s: gzip response %u of %u bytes, saved %d bytes, inflate time = %u us",
+            func,
+            gzip_stats.compressed_bytes,
+            gzip_stats.inflated_bytes,
+            (int)((int64_t)gzip_stats.inflated_bytes - gzip_stats.compressed_bytes),
+            gzip_stats.inflate_us
+        ));
+    }
+}
+
+// checks the scanned Web API response, for the 'ok' field and all fields after it
+static int slack_client_check_response(json_scanner_t* scanner, const char* func, json_scanner_field_t* fields, size_t num_fields)
+{
+    if (!json_scanner_done(scanner)) {
+        LogError(("%s: invalid JSON response!", func));
+        return -1;
+    }
+
+    if (!fields[0].found) {
+        LogError(("%s: no 'ok' field in response!", func));
         return -1;
     }
 
-    if (wss_client_init(&client->wss, ISRG_Root_X1_der, sizeof(ISRG_Root_X1_der), client->buf, client->buf_len) != 0) {
-        LogError(("slack_client_open_app_connection: wss_client_init failed!"));
+    if (strcmp(fields[0].value, "true") != 0) {
+        LogError(("%s: 'ok' response value is false, error = %s", func, fields[1].value));
         return -1;
     }
 
+    for (size_t i = 2; i < num_fields; i++) {
+        if (!fields[i].found) {
+            LogError(("%s: no '%s' field in response!", func, fields[i].key));
+            return -1;
+        }
+
+        if (fields[i].truncated) {
+            LogError(("%s: '%s' field in response is too long!", func, fields[i].key));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// per_minute and burst of the Web API tiers, chat.postMessage is limited per channel too
+static const struct {
+    uint32_t per_minute;
+    uint32_t burst;
+} slack_client_tier_limits[SLACK_CLIENT_TIER_COUNT] = {
+    [SLACK_CLIENT_TIER_1] = { 1, 3 },
+    [SLACK_CLIENT_TIER_4] = { 100, 10 },
+    [SLACK_CLIENT_TIER_POST_MESSAGE] = { 100, 10 }
+};
+
+static slack_client_channel_limit_t* slack_client_find_channel_limit(slack_client_t* client, const char* channel)
+{
+    for (int i = 0; i < SLACK_CLIENT_RATE_LIMIT_CHANNELS; i++) {
+        if (strcmp(client->channel_limits[i].channel, channel) == 0) {
+            return &client->channel_limits[i];
+        }
+    }
+
+    return NULL;
+}
+
+// ticks until a request of the tier, to the channel if not NULL, is within the rate limits
+static TickType_t slack_client_rate_limit_delay(slack_client_t* client, slack_client_tier_t tier, const char* channel)
+{
+    TickType_t delay = rate_limiter_delay(&client->tier_limits[tier]);
+
+    if (channel != NULL) {
+        slack_client_channel_limit_t* channel_limit = slack_client_find_channel_limit(client, channel);
+
+        if (channel_limit != NULL) {
+            TickType_t channel_delay = rate_limiter_delay(&channel_limit->limiter);
+
+            if (channel_delay > delay) {
+                delay = channel_delay;
+            }
+        }
+    }
+
+    return delay;
+}
+
+static void slack_client_rate_limit_take(slack_client_t* client, slack_client_tier_t tier, const char* channel)
+{
+    rate_limiter_take(&client->tier_limits[tier]);
+
+    if (channel == NULL) {
+        return;
+    }
+
+    slack_client_channel_limit_t* channel_limit = slack_client_find_channel_limit(client, channel);
+
+    if (channel_limit == NULL) {
+        // an idle limit is no different from a new one, otherwise the oldest is replaced
+        for (int i = 0; i < SLACK_CLIENT_RATE_LIMIT_CHANNELS; i++) {
+            if (rate_limiter_idle(&client->channel_limits[i].limiter)) {
+                channel_limit = &client->channel_limits[i];
+                break;
+            }
+        }
+
+        if (channel_limit == NULL) {
+            channel_limit = &client->channel_limits[client->channel_limit_next];
+            client->channel_limit_next = (client->channel_limit_next + 1) % SLACK_CLIENT_RATE_LIMIT_CHANNELS;
+        }
+
+        strcpy(channel_limit->channel, channel);
+        rate_limiter_init(&channel_limit->limiter, SLACK_CLIENT_CHANNEL_PER_MINUTE, SLACK_CLIENT_CHANNEL_BURST);
+    }
+
+    rate_limiter_take(&channel_limit->limiter);
+}
+
+// waits for the rate limits with web_api_lock held, it is given up while waiting
+static void slack_client_rate_limit_wait(slack_client_t* client, slack_client_tier_t tier, const char* channel)
+{
+    TickType_t delay;
+
+    while ((delay = slack_client_rate_limit_delay(client, tier, channel)) > 0) {
+        xSemaphoreGive(client->web_api_lock);
+        vTaskDelay(delay);
+        xSemaphoreTake(client->web_api_lock, portMAX_DELAY);
+    }
+
+    slack_client_rate_limit_take(client, tier, channel);
+}
+
+// holds back the tier for as long as Slack asked after a 429 response, returns 1 if it was one
+static int slack_client_check_throttled(slack_client_t* client, const char* func, slack_client_tier_t tier, uint16_t status_code, uint32_t retry_after)
+{
+    if (status_code != 429) {
+        return 0;
+    }
+
+    // Slack always sends Retry-After with 429, wait a second if it was left out
+    if (retry_after == 0) {
+        retry_after = 1;
+    }
+
+    LogWarn(("%s: rate limited, retry after %u s", func, retry_after));
+
+    rate_limiter_block(&client->tier_limits[tier], retry_after);
+    client->send_stats.throttled++;
+
+    return 1;
+}
+
+// Web API request to slack.com with the bot token
+static int slack_client_bot_request_template(slack_client_t* client, https_request_template_t* request_template, const char* path, const char* content_type)
+{
     char auth_header[128];
 
-    snprintf(
-        auth_header,
-        sizeof(auth_header),
-        "Bearer %s",
-        client->app_token
-    );
+    snprintf(auth_header, sizeof(auth_header), "Bearer %s", client->bot_token);
 
-    enum HTTPStatus status = https_client_post(
+    return https_client_template_init(
         &client->https,
+        request_template,
+        HTTP_METHOD_POST,
         "slack.com",
-        "/api/apps.connections.open",
+        path,
         (const char*[]){
-            "Authorization", auth_header
+            "Authorization", auth_header,
+            "Content-Type", content_type
         },
-        1,
-        NULL,
-        0
+        2
     );
+}
 
-    if (status != HTTPSuccess) {
-        LogError(("slack_client_open_app_connection: status != HTTPSuccess"));
+static void slack_client_sender_task(void* arg);
+
+int slack_client_init(slack_client_t* client, tls_config_t* tls_config, const char* bot_token, const char* app_token)
+{
+    client->tls_config = tls_config;
+    client->bot_token = bot_token;
+    client->app_token = app_token;
+    client->wss_connecting = 0;
+    client->ack_first = 0;
+    client->acked_envelope_id[0] = '\0';
+    client->num_held = 0;
+    client->channel_limit_next = 0;
+    memset(&client->send_stats, 0x00, sizeof(client->send_stats));
+
+    for (int i = 0; i < SLACK_CLIENT_TIER_COUNT; i++) {
+        rate_limiter_init(&client->tier_limits[i], slack_client_tier_limits[i].per_minute, slack_client_tier_limits[i].burst);
+    }
+
+    for (int i = 0; i < SLACK_CLIENT_RATE_LIMIT_CHANNELS; i++) {
+        client->channel_limits[i].channel[0] = '\0';
+        rate_limiter_init(&client->channel_limits[i].limiter, SLACK_CLIENT_CHANNEL_PER_MINUTE, SLACK_CLIENT_CHANNEL_BURST);
+    }
+
+    if (https_client_init(&client->https, tls_config) != 0) {
+        LogError(("slack_client_init: https_client_init failed!"));
         return -1;
     }
 
-    if (client->https.response.statusCode != 200) {
-        LogError(("slack_client_open_app_connection: client->https.response.statusCode = %u", client->https.response.statusCode));
+    // Web API calls all go to slack.com, keep the connection open between them
+    https_client_set_keep_alive(&client->https, 1);
+    https_client_set_body_consumer(&client->https, slack_client_consume_response, &client->response);
+
+    if (https_client_set_gzip(&client->https, 1) != 0) {
+        LogWarn(("slack_client_init: https_client_set_gzip failed, Web API responses come uncompressed"));
+    }
+
+    // the Web API requests only differ in their body, their headers are built once here
+    char auth_header[128];
+
+    snprintf(auth_header, sizeof(auth_header), "Bearer %s", app_token);
+
+    if (https_client_template_init(
+            &client->https,
+            &client->connections_open_request,
+            HTTP_METHOD_POST,
+            "slack.com",
+            "/api/apps.connections.open",
+            (const char*[]){
+                "Authorization", auth_header
+            },
+            1) != 0) {
+        LogError(("slack_client_init: https_client_template_init failed!"));
+        return -1;
+    }
+
+    if (slack_client_bot_request_template(client, &client->post_message_request, "/api/chat.postMessage", "application/json;charset=utf8") != 0) {
+        LogError(("slack_client_init: https_client_template_init failed!"));
+        return -1;
+    }
+
+    if (wss_client_init(&client->wss, tls_config) != 0) {
+        LogError(("slack_client_init: wss_client_init failed!"));
         return -1;
     }
 
-    cJSON* json = cJSON_ParseWithLength(client->https.response.pBody, client->https.response.bodyLen);
+    wss_client_set_consumer(&client->wss, slack_client_consume_large_message, client);
+    wss_client_set_deflate(&client->wss, 1);
 
-    if (json == NULL) {
-        LogError(("slack_client_open_app_connection: cJSON_ParseWithLength failed!"));
+    // the https pool is not thread safe, so Web API calls, apps.connections.open
+    // included, are serialized by this lock, reopening the app connection waits
+    // for a post or upload in flight, including its connect, but not for one that
+    // is waiting on its rate limits or to be retried, the lock is given up then
+    client->web_api_lock = xSemaphoreCreateMutex();
+    if (client->web_api_lock == NULL) {
+        LogError(("slack_client_init: xSemaphoreCreateMutex failed!"));
         return -1;
     }
 
-    cJSON* ok_json = cJSON_GetObjectItemCaseSensitive(json, "ok");
-    if (ok_json == NULL) {
-        LogError(("slack_client_open_app_connection: no 'ok' field in response!"));
-        cJSON_Delete(json);
+    client->send_queue = xQueueCreate(SLACK_CLIENT_SEND_QUEUE_LEN, sizeof(slack_client_send_request_t));
+    if (client->send_queue == NULL) {
+        LogError(("slack_client_init: xQueueCreate failed!"));
         return -1;
     }
 
-    if (cJSON_IsFalse(ok_json)) {
-        LogError(("slack_client_open_app_connection: 'ok' response value is false!"));
-        cJSON_Delete(json);
+    if (xTaskCreate(slack_client_sender_task, "SlackSender", SLACK_CLIENT_SENDER_STACK_SIZE, client, SLACK_CLIENT_SENDER_PRIORITY, &client->sender) != pdPASS) {
+        LogError(("slack_client_init: xTaskCreate failed!"));
         return -1;
     }
 
-    cJSON* url_json = cJSON_GetObjectItemCaseSensitive(json, "url");
-    if (url_json == NULL) {
-        LogError(("slack_client_open_app_connection: no 'url' field in response!"));
-        cJSON_Delete(json);
+    return 0;
+}
+
+int slack_client_open_app_connection(slack_client_t* client)
+{
+    char ok[8];
+    char error[64];
+    char url[384];
+    json_scanner_field_t fields[] = {
+        { "ok", ok, sizeof(ok) },
+        { "error", error, sizeof(error) },
+        { "url", url, sizeof(url) }
+    };
+
+    json_scanner_init(&client->response, fields, sizeof(fields) / sizeof(fields[0]));
+
+    rate_limiter_take(&client->tier_limits[SLACK_CLIENT_TIER_1]);
+
+    enum HTTPStatus status = https_client_template_send(&client->https, &client->connections_open_request, NULL, 0);
+
+    if (status != HTTPSuccess) {
+        LogError(("slack_client_open_app_connection: status != HTTPSuccess"));
         return -1;
     }
 
-    const char* url = cJSON_GetStringValue(url_json);
-    if (url == NULL) {
-        LogError(("slack_client_open_app_connection: 'url' field in response is not a string!"));
-        cJSON_Delete(json);
+    slack_client_log_gzip_stats(client, "slack_client_open_app_connection");
+
+    if (slack_client_check_throttled(client, "slack_client_open_app_connection", SLACK_CLIENT_TIER_1, client->https.response.statusCode, client->https.retry_after)) {
         return -1;
     }
 
-    LogDebug(("slack_client_open_app_connection: url = %s", url));
+    if (client->https.response.statusCode != 200) {
+        LogError(("slack_client_open_app_connection: client->https.response.statusCode = %u", client->https.response.statusCode));
+        return -1;
+    }
 
-    if (strstr(url, "wss://") != url) {
-        LogError(("slack_client_open_app_connection: 'url' field in response is not a string!"));
-        cJSON_Delete(json);
+    if (slack_client_check_response(&client->response, "slack_client_open_app_connection", fields, sizeof(fields) / sizeof(fields[0])) != 0) {
         return -1;
     }
 
-    char wss_host[64];
-    char wss_path[256];
+    LogDebug(("slack_client_open_app_connection: url = %s", url));
+
+    if (strstr(url, "wss://") != url || strchr(url + 6, '/') == NULL) {
+        LogError(("slack_client_open_app_connection: 'url' field in response is not a wss:// URL!"));
+        return -1;
+    }
 
     const char* host_start = url + 6;
     const char* path_start = strchr(host_start, '/');
+    size_t host_len = path_start - host_start;
 
-    memset(wss_host, 0x00, sizeof(wss_host));
-    memset(wss_path, 0x00, sizeof(wss_path));
+    if (host_len >= sizeof(client->wss_host)) {
+        LogError(("slack_client_open_app_connection: 'url' field in response has a host name that is too long!"));
+        return -1;
+    }
 
-    strncpy(wss_host, host_start, (path_start - host_start));
-    strncpy(wss_path, path_start, sizeof(wss_path));
+    memcpy(client->wss_host, host_start, host_len);
+    client->wss_host[host_len] = '\0';
 
     // append debug_reconnects to URL to shorten connection time
-    strncat(wss_path, "&debug_reconnects=true", sizeof(wss_path) - 1);
-
-    cJSON_Delete(json);
+    int path_len = snprintf(client->wss_path, sizeof(client->wss_path), "%s&debug_reconnects=true", path_start);
 
-    status = ws_client_open(&client->wss, wss_host, wss_path);
+    if (path_len < 0 || (size_t)path_len >= sizeof(client->wss_path)) {
+        LogError(("slack_client_open_app_connection: 'url' field in response has a path that is too long!"));
+        return -1;
+    }
 
-    if (status != HTTPSuccess) {
-        LogError(("slack_client_open_app_connection: ws_client_open failed!"));
+    // the connection is set up from slack_client_poll, so the caller keeps running meanwhile
+    if (ws_client_connect_start(&client->wss, client->wss_host) != 0) {
+        LogError(("slack_client_open_app_connection: ws_client_connect_start failed!"));
         return -1;
     }
 
+    client->wss_connecting = 1;
+
     return 0;
 }
 
+static int slack_client_poll_app_connection(slack_client_t* client)
+{
+    int result = ws_client_connect_poll(&client->wss);
+
+    if (result == 0) {
+        return 0;
+    }
+
+    client->wss_connecting = 0;
+
+    if (result < 0) {
+        LogError(("slack_client_poll_app_connection: ws_client_connect_poll failed!"));
+        wss_client_close(&client->wss);
+        return -1;
+    }
+
+    if (ws_client_open(&client->wss, client->wss_host, client->wss_path) != HTTPSuccess) {
+        LogError(("slack_client_poll_app_connection: ws_client_open failed!"));
+        wss_client_close(&client->wss);
+        return -1;
+    }
+
+    return 1;
+}
+
+void slack_client_set_ack_first(slack_client_t* client, int ack_first)
+{
+    client->ack_first = ack_first;
+}
+
+// acknowledges the envelope in the frame, envelopes that accept a response
+// payload are left for the handler to acknowledge
+static void slack_client_ack_envelope(slack_client_t* client, const wss_frame_t* frame)
+{
+    char envelope_id[SLACK_CLIENT_ENVELOPE_ID_MAX_LEN];
+    char accepts_response_payload[8];
+    json_scanner_field_t fields[] = {
+        { "envelope_id", envelope_id, sizeof(envelope_id) },
+        { "accepts_response_payload", accepts_response_payload, sizeof(accepts_response_payload) }
+    };
+    json_scanner_t scanner;
+
+    json_scanner_init(&scanner, fields, sizeof(fields) / sizeof(fields[0]));
+
+    if (json_scanner_feed(&scanner, frame->payload, frame->len) != 0 || !fields[0].found || fields[0].truncated) {
+        return;
+    }
+
+    if (fields[1].found && strcmp(accepts_response_payload, "true") == 0) {
+        return;
+    }
+
+    if (slack_client_acknowledge_event(client, envelope_id, NULL) != 0) {
+        return;
+    }
+
+    strcpy(client->acked_envelope_id, envelope_id);
+}
+
 cJSON* slack_client_poll(slack_client_t* client)
 {
-    if (!ws_client_connected(&client->wss)) {
+    // a post in progress on the sender task keeps the pool busy anyway
+    if (xSemaphoreTake(client->web_api_lock, 0) == pdTRUE) {
+        https_client_pool_prune();
+        xSemaphoreGive(client->web_api_lock);
+    }
+
+    if (client->wss_connecting) {
+        // the handshake deadlines keep running, so this does not wait for the sender task's posts
+        int result = slack_client_poll_app_connection(client);
+
+        if (result != 1) {
+            return NULL;
+        }
+
+        tls_arena_stats_t arena_stats;
+        tls_arena_get_stats(&arena_stats);
+
+        dns_cache_stats_t dns_stats;
+        dns_cache_get_stats(&dns_stats);
+
+        buf_pool_stats_t buf_stats;
+        buf_pool_get_stats(&buf_stats);
+
+        slack_client_send_stats_t send_stats;
+        slack_client_get_send_stats(client, &send_stats);
+
+        LogDebug(("slack_client_poll: app connection opened"));
+        LogDebug(("slack_client_poll: TLS arena used = %u, peak = %u, size = %u, failed = %u", arena_stats.used, arena_stats.peak, arena_stats.size, arena_stats.failed));
+        LogDebug(("slack_client_poll: DNS cache hits = %u, misses = %u, invalidations = %u", dns_stats.hits, dns_stats.misses, dns_stats.invalidations));
+        LogDebug(("slack_client_poll: buffer pool in use = %u, peak = %u, buffers = %u, failed = %u", buf_stats.in_use, buf_stats.peak, buf_stats.num_bufs, buf_stats.failed));
+        LogDebug(("slack_client_poll: send queue depth = %u, peak = %u, sent = %u, failed = %u, throttled = %u, delayed = %u, max delay = %u ms", send_stats.depth, send_stats.peak_depth, send_stats.sent, send_stats.failed, send_stats.throttled, send_stats.delayed, send_stats.max_delay_ms));
+    } else if (!ws_client_connected(&client->wss)) {
+        // apps.connections.open is Tier 1, only this task uses the Tier 1 limit
+        if (rate_limiter_delay(&client->tier_limits[SLACK_CLIENT_TIER_1]) > 0) {
+            return NULL;
+        }
+
+        wss_ping_stats_t ping_stats;
+        wss_client_get_ping_stats(&client->wss, &ping_stats);
+
+        if (ping_stats.pings > 0) {
+            LogDebug(("slack_client_poll: app connection lost, pings = %u, pongs = %u, rtt = %u us, srtt = %u us", ping_stats.pings, ping_stats.pongs, ping_stats.rtt_us, ping_stats.srtt_us));
+        }
+
         wss_client_close(&client->wss);
 
         LogDebug(("slack_client_poll: opening app connection"));
 
-        if (slack_client_open_app_connection(client) != 0) {
+        xSemaphoreTake(client->web_api_lock, portMAX_DELAY);
+        int result = slack_client_open_app_connection(client);
+        xSemaphoreGive(client->web_api_lock);
+
+        if (result != 0) {
             LogError(("slack_client_poll: Failed to open app connection!"));
-            return NULL;
         }
 
-        LogDebug(("slack_client_poll: app connection opened"));
+        return NULL;
     }
 
-    uint8_t type;
-    int result = wss_client_read(&client->wss, &type, client->buf, client->buf_len);
+    // pongs and acks queued since the last poll go out together
+    if (wss_client_flush(&client->wss) != 0) {
+        LogError(("slack_client_poll: wss_client_flush failed!"));
+        wss_client_close(&client->wss);
+        return NULL;
+    }
+
+    wss_client_cork(&client->wss);
+
+    wss_frame_t frame;
+    int result = wss_client_read_frame(&client->wss, &frame);
 
     if (result <= 0) {
         return NULL;
     }
 
-    if (type == WEBSOCKET_OPCODE_PING) {
+    if (frame.type == WEBSOCKET_OPCODE_PING) {
         LogDebug(("slack_client_poll: got ping, sending pong ..."));
         // ping, send pong
-        wss_client_write(&client->wss, WEBSOCKET_OPCODE_PONG, client->buf, result);
+        wss_client_write(&client->wss, WEBSOCKET_OPCODE_PONG, frame.payload, frame.len);
 
         return NULL;
-    } else if (type == WEBSOCKET_OPCODE_CONNECTION_CLOSE) {
+    } else if (frame.type == WEBSOCKET_OPCODE_CONNECTION_CLOSE) {
         LogDebug(("slack_client_poll: got connection close"));
 
         wss_client_close(&client->wss);
@@ -170,132 +552,640 @@ cJSON* slack_client_poll(slack_client_t* client)
         return NULL;
     }
 
-    cJSON* json = cJSON_ParseWithLength(client->buf, result);
+    wss_deflate_stats_t deflate_stats;
+    wss_client_get_deflate_stats(&client->wss, &deflate_stats);
+
+    if (deflate_stats.inflated_bytes > 0) {
+        LogDebug((
+            "slack_client_poll: permessage-deflate messages = %u, compressed to %u%% (%u of %u bytes), inflate time = %u us",
+            deflate_stats.messages,
+            (uint32_t)((uint64_t)deflate_stats.compressed_bytes * 100 / deflate_stats.inflated_bytes),
+            deflate_stats.compressed_bytes,
+            deflate_stats.inflated_bytes,
+            deflate_stats.inflate_us
+        ));
+    }
+
+    if (client->ack_first && frame.type == WEBSOCKET_OPCODE_TEXT) {
+        slack_client_ack_envelope(client, &frame);
+    }
+
+    cJSON* json = cJSON_ParseWithLength(frame.payload, frame.len);
 
     return json;
 }
 
 int slack_client_acknowledge_event(slack_client_t* client, const char* envelope_id, cJSON* payload)
 {
-    cJSON* json = cJSON_CreateObject();
-    if (json == NULL) {
-        return -1;
+    // the handler of an envelope acknowledged in slack_client_poll does not need to know
+    if (strcmp(envelope_id, client->acked_envelope_id) == 0) {
+        if (payload != NULL) {
+            LogWarn(("slack_client_acknowledge_event: envelope_id = %s was acknowledged without payload", envelope_id));
+            cJSON_Delete(payload);
+            return -1;
+        }
+
+        return 0;
     }
 
-    cJSON* envelope_id_json = cJSON_CreateString(envelope_id);
-    if (envelope_id_json == NULL) {
-        cJSON_Delete(json);
+    char ack[SLACK_CLIENT_ACK_MAX_LEN];
+    char* body = ack;
+    size_t body_len = sizeof(ack);
+    char* payload_json = NULL;
+
+    // only acks with a payload allocate, steady state acks are written on the stack
+    if (payload != NULL) {
+        payload_json = cJSON_PrintUnformatted(payload);
+        cJSON_Delete(payload);
+
+        if (payload_json == NULL) {
+            return -1;
+        }
+
+        body_len += strlen(payload_json);
+        body = malloc(body_len);
+
+        if (body == NULL) {
+            cJSON_free(payload_json);
+            return -1;
+        }
+    }
+
+    json_writer_t writer;
+    json_writer_init(&writer, body, body_len);
+    json_writer_begin_object(&writer);
+    json_writer_key(&writer, "envelope_id");
+    json_writer_string(&writer, envelope_id);
+
+    if (payload_json != NULL) {
+        json_writer_key(&writer, "payload");
+        json_writer_raw(&writer, payload_json);
+    }
+
+    json_writer_end_object(&writer);
+
+    int len = json_writer_finish(&writer);
+    int result = -1;
+
+    if (len < 0) {
+        LogError(("slack_client_acknowledge_event: envelope_id = %s is too long!", envelope_id));
+    } else {
+        LogDebug(("slack_client_acknowledge_event: body = %s", body));
+
+        result = wss_client_write(&client->wss, WEBSOCKET_OPCODE_TEXT, (const uint8_t*)body, len);
+    }
+
+    // Slack redelivers envelopes that are not acknowledged within 3 s, so the ack
+    // goes out now instead of waiting for the next poll, however long the handler takes
+    if (result == 0) {
+        result = wss_client_flush(&client->wss);
+
+        if (result != 0) {
+            LogError(("slack_client_acknowledge_event: wss_client_flush failed!"));
+        }
+
+        wss_client_cork(&client->wss);
+    }
+
+    if (payload_json != NULL) {
+        cJSON_free(payload_json);
+        free(body);
+    }
+
+    return result;
+}
+
+// chat.postMessage body, returns its length or -1 if it does not fit
+static int slack_client_message_body(char* buf, size_t len, const char* text, const char* channel)
+{
+    json_writer_t writer;
+
+    json_writer_init(&writer, buf, len);
+    json_writer_begin_object(&writer);
+    json_writer_key(&writer, "text");
+    json_writer_string(&writer, text);
+    json_writer_key(&writer, "channel");
+    json_writer_string(&writer, channel);
+    json_writer_end_object(&writer);
+
+    return json_writer_finish(&writer);
+}
+
+static int slack_client_send_message(slack_client_t* client, const char* text, const char* channel)
+{
+    buf_lease_t lease;
+
+    if (buf_pool_acquire(&lease, BUF_POOL_OWNER_JSON) != 0) {
+        LogError(("slack_client_post_message: buf_pool_acquire failed!"));
         return -1;
     }
-    cJSON_AddItemToObject(json, "envelope_id", envelope_id_json);
 
+    int body_len = slack_client_message_body((char*)lease.buf, lease.len, text, channel);
 
-    if (payload != NULL) {
-        cJSON_AddItemToObject(json, "payload", payload);
+    if (body_len < 0) {
+        LogError(("slack_client_post_message: message is too long!"));
+        buf_pool_release(&lease);
+        return -1;
     }
 
-    char* body = cJSON_PrintUnformatted(json);
-    if (body == NULL) {
-        cJSON_Delete(json);
+    char ok[8];
+    char error[64];
+    json_scanner_field_t fields[] = {
+        { "ok", ok, sizeof(ok) },
+        { "error", error, sizeof(error) }
+    };
+
+    json_scanner_init(&client->response, fields, sizeof(fields) / sizeof(fields[0]));
+
+    enum HTTPStatus status = https_client_template_send(&client->https, &client->post_message_request, (const char*)lease.buf, body_len);
+
+    buf_pool_release(&lease);
+
+    if (status != HTTPSuccess) {
+        LogError(("slack_client_post_message: status != HTTPSuccess, %d", status));
         return -1;
     }
 
-    LogDebug(("slack_client_acknowledge_event: body = %s", body));
+    slack_client_log_gzip_stats(client, "slack_client_post_message");
+
+    if (slack_client_check_throttled(client, "slack_client_post_message", SLACK_CLIENT_TIER_POST_MESSAGE, client->https.response.statusCode, client->https.retry_after)) {
+        return -1;
+    }
 
-    int result = wss_client_write(&client->wss, WEBSOCKET_OPCODE_TEXT, body, strlen(body));
+    if (client->https.response.statusCode != 200) {
+        LogError(("slack_client_post_message: client->https.response.statusCode = %d", client->https.response.statusCode));
+        return -1;
+    }
 
-    cJSON_Delete(json);
+    if (slack_client_check_response(&client->response, "slack_client_post_message", fields, sizeof(fields) / sizeof(fields[0])) != 0) {
+        return -1;
+    }
 
     return 0;
 }
 
 int slack_client_post_message(slack_client_t* client, const char* text, const char* channel)
 {
-    if (https_client_init(&client->https, ISRG_Root_X1_der, sizeof(ISRG_Root_X1_der), client->buf, client->buf_len) != 0) {
+    // channels are rate limited by name, which has to fit in the limit table
+    if (strlen(channel) >= SLACK_CLIENT_SEND_CHANNEL_MAX_LEN) {
+        LogError(("slack_client_post_message: channel %s is too long!", channel));
         return -1;
     }
 
-    char auth_header[128];
+    xSemaphoreTake(client->web_api_lock, portMAX_DELAY);
+    slack_client_rate_limit_wait(client, SLACK_CLIENT_TIER_POST_MESSAGE, channel);
+    int result = slack_client_send_message(client, text, channel);
+    xSemaphoreGive(client->web_api_lock);
 
-    snprintf(
-        auth_header,
-        sizeof(auth_header),
-        "Bearer %s",
-        client->bot_token
-    );
+    return result;
+}
+
+// sends the first held message its rate limits allow, messages to the same
+// channel keep their order, returns how long to wait if none could be sent
+static TickType_t slack_client_send_next(slack_client_t* client)
+{
+    TickType_t wait = portMAX_DELAY;
 
-    cJSON* json = cJSON_CreateObject();
-    if (json == NULL) {
+    xSemaphoreTake(client->web_api_lock, portMAX_DELAY);
+
+    for (size_t i = 0; i < client->num_held; i++) {
+        slack_client_send_request_t* request = &client->held[i];
+        int earlier = 0;
+
+        for (size_t j = 0; j < i; j++) {
+            if (strcmp(client->held[j].channel, request->channel) == 0) {
+                earlier = 1;
+                break;
+            }
+        }
+
+        if (earlier) {
+            continue;
+        }
+
+        TickType_t delay = slack_client_rate_limit_delay(client, SLACK_CLIENT_TIER_POST_MESSAGE, request->channel);
+
+        if (delay > 0) {
+            request->delayed = 1;
+
+            if (delay < wait) {
+                wait = delay;
+            }
+
+            continue;
+        }
+
+        slack_client_rate_limit_take(client, SLACK_CLIENT_TIER_POST_MESSAGE, request->channel);
+
+        int result = slack_client_send_message(client, request->text, request->channel);
+        int throttled = (result != 0 && client->https.response.statusCode == 429);
+
+        xSemaphoreGive(client->web_api_lock);
+
+        // throttled messages are held until the tier is open again
+        if (throttled && request->retries < SLACK_CLIENT_SEND_MAX_RETRIES) {
+            request->retries++;
+            request->delayed = 1;
+            return 0;
+        }
+
+        uint32_t delay_ms = (xTaskGetTickCount() - request->queued) * portTICK_PERIOD_MS;
+
+        client->send_stats.delay_ms += delay_ms;
+
+        if (delay_ms > client->send_stats.max_delay_ms) {
+            client->send_stats.max_delay_ms = delay_ms;
+        }
+
+        if (request->delayed) {
+            client->send_stats.delayed++;
+        }
+
+        if (result == 0) {
+            client->send_stats.sent++;
+        } else {
+            client->send_stats.failed++;
+        }
+
+        slack_client_send_request_t done = *request;
+
+        memmove(request, request + 1, (client->num_held - i - 1) * sizeof(*request));
+        client->num_held--;
+
+        if (done.sent != NULL) {
+            done.sent(done.sent_arg, result);
+        }
+
+        return 0;
+    }
+
+    xSemaphoreGive(client->web_api_lock);
+
+    return wait;
+}
+
+// posts the queued messages, so slack_client_poll is not held up by Web API round trips
+static void slack_client_sender_task(void* arg)
+{
+    slack_client_t* client = (slack_client_t*)arg;
+    TickType_t wait = portMAX_DELAY;
+
+    while (1) {
+        // new messages are taken in while waiting, they may be for a channel that is not held back
+        if (client->num_held < SLACK_CLIENT_SEND_QUEUE_LEN) {
+            if (xQueueReceive(client->send_queue, &client->held[client->num_held], (client->num_held == 0) ? portMAX_DELAY : wait) == pdTRUE) {
+                client->num_held++;
+                wait = 0;
+                continue;
+            }
+        } else if (wait > 0) {
+            vTaskDelay(wait);
+        }
+
+        wait = slack_client_send_next(client);
+    }
+}
+
+// queues the message for the sender task and returns without waiting for it,
+// returns -1 if the queue is full
+int slack_client_post_message_async(slack_client_t* client, const char* text, const char* channel, slack_client_sent_t sent, void* sent_arg)
+{
+    slack_client_send_request_t request;
+
+    if (strlen(text) >= sizeof(request.text)) {
+        LogError(("slack_client_post_message_async: text is too long!"));
         return -1;
     }
 
-    cJSON* text_json = cJSON_CreateString(text);
-    if (text_json == NULL) {
-        cJSON_Delete(json);
+    if (strlen(channel) >= sizeof(request.channel)) {
+        LogError(("slack_client_post_message_async: channel %s is too long!", channel));
         return -1;
     }
-    cJSON_AddItemToObject(json, "text", text_json);
 
-    cJSON* channel_json = cJSON_CreateString(channel);
-    if (channel_json == NULL) {
-        cJSON_Delete(json);
+    strcpy(request.text, text);
+    strcpy(request.channel, channel);
+    request.sent = sent;
+    request.sent_arg = sent_arg;
+    request.queued = xTaskGetTickCount();
+    request.retries = 0;
+    request.delayed = 0;
+
+    if (xQueueSend(client->send_queue, &request, 0) != pdTRUE) {
+        LogError(("slack_client_post_message_async: send queue is full!"));
+        client->send_stats.rejected++;
         return -1;
     }
-    cJSON_AddItemToObject(json, "channel", channel_json);
 
-    char* body = cJSON_PrintUnformatted(json);
-    if (body == NULL) {
-        cJSON_Delete(json);
+    client->send_stats.queued++;
+
+    uint32_t depth = uxQueueMessagesWaiting(client->send_queue) + client->num_held;
+
+    if (depth > client->send_stats.peak_depth) {
+        client->send_stats.peak_depth = depth;
+    }
+
+    return 0;
+}
+
+void slack_client_get_send_stats(slack_client_t* client, slack_client_send_stats_t* stats)
+{
+    *stats = client->send_stats;
+    stats->depth = uxQueueMessagesWaiting(client->send_queue) + client->num_held;
+}
+
+// posts several messages with one round trip, the messages arrive in order
+int slack_client_post_messages(slack_client_t* client, const char* texts[], size_t num_texts, const char* channel)
+{
+    struct {
+        json_scanner_t scanner;
+        json_scanner_field_t fields[2];
+        char ok[8];
+        char error[64];
+    } responses[SLACK_CLIENT_PIPELINE_MAX_REQUESTS];
+    https_pipeline_request_t requests[SLACK_CLIENT_PIPELINE_MAX_REQUESTS];
+    buf_lease_t lease;
+    size_t used = 0;
+
+    if (num_texts > SLACK_CLIENT_PIPELINE_MAX_REQUESTS) {
+        LogError(("slack_client_post_messages: more than %d messages", SLACK_CLIENT_PIPELINE_MAX_REQUESTS));
         return -1;
     }
 
-    enum HTTPStatus status = https_client_post(
-        &client->https,
-        "slack.com",
-        "/api/chat.postMessage",
-        (const char*[]){
-            "Authorization", auth_header,
-            "Content-Type", "application/json;charset=utf8"
-        },
-        2,
-        body,
-        strlen(body)
-    );
+    if (strlen(channel) >= SLACK_CLIENT_SEND_CHANNEL_MAX_LEN) {
+        LogError(("slack_client_post_messages: channel %s is too long!", channel));
+        return -1;
+    }
+
+    xSemaphoreTake(client->web_api_lock, portMAX_DELAY);
+
+    // the lock is given up while waiting, so the lease is only taken after it, or the
+    // sender task could find the pool empty in the meantime
+    for (size_t i = 0; i < num_texts; i++) {
+        slack_client_rate_limit_wait(client, SLACK_CLIENT_TIER_POST_MESSAGE, channel);
+    }
+
+    // the bodies are written one after the other into one buffer
+    if (buf_pool_acquire(&lease, BUF_POOL_OWNER_JSON) != 0) {
+        LogError(("slack_client_post_messages: buf_pool_acquire failed!"));
+        xSemaphoreGive(client->web_api_lock);
+        return -1;
+    }
+
+    for (size_t i = 0; i < num_texts; i++) {
+        int body_len = slack_client_message_body((char*)&lease.buf[used], lease.len - used, texts[i], channel);
+
+        if (body_len < 0) {
+            LogError(("slack_client_post_messages: messages are too long!"));
+            buf_pool_release(&lease);
+            xSemaphoreGive(client->web_api_lock);
+            return -1;
+        }
+
+        responses[i].fields[0] = (json_scanner_field_t){ "ok", responses[i].ok, sizeof(responses[i].ok) };
+        responses[i].fields[1] = (json_scanner_field_t){ "error", responses[i].error, sizeof(responses[i].error) };
+
+        json_scanner_init(&responses[i].scanner, responses[i].fields, 2);
+
+        requests[i].request_template = &client->post_message_request;
+        requests[i].body = (const char*)&lease.buf[used];
+        requests[i].body_len = body_len;
+        requests[i].body_consumer = slack_client_consume_response;
+        requests[i].body_consumer_arg = &responses[i].scanner;
+
+        used += body_len + 1;
+    }
+
+    enum HTTPStatus status = https_client_pipeline(&client->https, requests, num_texts);
+
+    for (size_t i = 0; i < num_texts; i++) {
+        slack_client_check_throttled(client, "slack_client_post_messages", SLACK_CLIENT_TIER_POST_MESSAGE, requests[i].status_code, requests[i].retry_after);
+    }
+
+    buf_pool_release(&lease);
+    xSemaphoreGive(client->web_api_lock);
+
+    int result = 0;
 
     if (status != HTTPSuccess) {
-        LogError(("slack_client_post_message: status != HTTPSuccess, %d", status));
-        cJSON_Delete(json);
+        LogError(("slack_client_post_messages: status != HTTPSuccess, %d", status));
+        result = -1;
+    }
+
+    for (size_t i = 0; i < num_texts; i++) {
+        if (requests[i].status == HTTPNoResponse && requests[i].written) {
+            // not resent, posting it again could show the message twice
+            LogError(("slack_client_post_messages: no response to message %u, it may have been posted", (unsigned int)i));
+            continue;
+        } else if (requests[i].status != HTTPSuccess) {
+            continue;
+        }
+
+        if (requests[i].status_code != 200) {
+            LogError(("slack_client_post_messages: message %u status code = %d", (unsigned int)i, requests[i].status_code));
+            result = -1;
+        } else if (slack_client_check_response(&responses[i].scanner, "slack_client_post_messages", responses[i].fields, 2) != 0) {
+            result = -1;
+        }
+    }
+
+    return result;
+}
+
+// form field value, percent-encoded, returns -1 if it does not fit
+static int slack_client_form_encode(char* dst, size_t dst_len, const char* value)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    size_t len = strlen(dst);
+
+    for (; *value != '\0'; value++) {
+        uint8_t c = *value;
+
+        if (len + 4 > dst_len) {
+            return -1;
+        }
+
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.' || c == '~') {
+            dst[len++] = c;
+        } else {
+            dst[len++] = '%';
+            dst[len++] = hex[c >> 4];
+            dst[len++] = hex[c & 0xf];
+        }
+    }
+
+    dst[len] = '\0';
+
+    return 0;
+}
+
+// sends a Web API request and checks its response for the fields
+static int slack_client_api_call(
+    slack_client_t* client,
+    const char* func,
+    slack_client_tier_t tier,
+    const https_request_template_t* request_template,
+    const char* body,
+    json_scanner_field_t* fields,
+    size_t num_fields
+)
+{
+    slack_client_rate_limit_wait(client, tier, NULL);
+
+    json_scanner_init(&client->response, fields, num_fields);
+
+    enum HTTPStatus status = https_client_template_send(&client->https, request_template, body, strlen(body));
+
+    if (status != HTTPSuccess) {
+        LogError(("%s: status != HTTPSuccess, %d", func, status));
+        return -1;
+    }
+
+    slack_client_log_gzip_stats(client, func);
+
+    if (slack_client_check_throttled(client, func, tier, client->https.response.statusCode, client->https.retry_after)) {
         return -1;
     }
 
     if (client->https.response.statusCode != 200) {
-        LogError(("slack_client_post_message: client->https.response.statusCode = %d", client->https.response.statusCode));
-        cJSON_Delete(json);
+        LogError(("%s: client->https.response.statusCode = %d", func, client->https.response.statusCode));
         return -1;
     }
 
-    cJSON_Delete(json);
+    return slack_client_check_response(&client->response, func, fields, num_fields);
+}
 
-    json = cJSON_ParseWithLength(client->https.response.pBody, client->https.response.bodyLen);
-    if (json == NULL) {
-        LogError(("slack_client_post_message: cJSON_ParseWithLength failed!"));
+static int slack_client_send_file(
+    slack_client_t* client,
+    const char* channel_id,
+    const char* filename,
+    size_t length,
+    https_body_producer_t producer,
+    void* arg
+)
+{
+    https_request_template_t request_template;
+    char form[160] = "filename=";
+    char ok[8];
+    char error[64];
+    char upload_url[384];
+    char file_id[32];
+    json_scanner_field_t fields[] = {
+        { "ok", ok, sizeof(ok) },
+        { "error", error, sizeof(error) },
+        { "upload_url", upload_url, sizeof(upload_url) },
+        { "file_id", file_id, sizeof(file_id) }
+    };
+
+    // leaves room for the length field
+    if (slack_client_form_encode(form, sizeof(form) - sizeof("&length=4294967295"), filename) != 0) {
+        LogError(("slack_client_upload_file: file name %s is too long!", filename));
         return -1;
     }
 
-    cJSON* ok_json = cJSON_GetObjectItemCaseSensitive(json, "ok");
-    if (ok_json == NULL) {
-        LogError(("slack_client_post_message: no 'ok' field in response!"));
-        cJSON_Delete(json);
+    size_t form_len = strlen(form);
+    int result = snprintf(&form[form_len], sizeof(form) - form_len, "&length=%u", (unsigned int)length);
+
+    if (result < 0 || (size_t)result >= sizeof(form) - form_len) {
+        LogError(("slack_client_upload_file: length %u does not fit in the form!", (unsigned int)length));
         return -1;
     }
 
-    if (cJSON_IsFalse(ok_json)) {
-        LogError(("slack_client_post_message: 'ok' response value is false!"));
-        cJSON_Delete(json);
+    if (slack_client_bot_request_template(client, &request_template, "/api/files.getUploadURLExternal", "application/x-www-form-urlencoded") != 0 ||
+        slack_client_api_call(client, "slack_client_upload_file", SLACK_CLIENT_TIER_4, &request_template, form, fields, 4) != 0) {
         return -1;
     }
 
-    cJSON_Delete(json);
+    // the file goes to the upload URL, which is on another host
+    char host[TLS_CLIENT_HOST_MAX_LEN];
 
-    return 0;
+    // the prefix is checked first, the host is only looked for after it
+    if (strncmp(upload_url, "https://", 8) != 0) {
+        LogError(("slack_client_upload_file: 'upload_url' field in response is not an https:// URL!"));
+        return -1;
+    }
+
+    const char* host_start = upload_url + 8;
+    const char* path_start = strchr(host_start, '/');
+
+    if (path_start == NULL || (size_t)(path_start - host_start) >= sizeof(host)) {
+        LogError(("slack_client_upload_file: 'upload_url' field in response is not an https:// URL!"));
+        return -1;
+    }
+
+    memcpy(host, host_start, path_start - host_start);
+    host[path_start - host_start] = '\0';
+
+    if (https_client_template_init(
+            &client->https,
+            &request_template,
+            HTTP_METHOD_POST,
+            host,
+            path_start,
+            (const char*[]){
+                "Content-Type", "application/octet-stream"
+            },
+            1) != 0) {
+        return -1;
+    }
+
+    // the upload response is not JSON
+    json_scanner_init(&client->response, NULL, 0);
+
+    enum HTTPStatus status = https_client_template_send_produced(&client->https, &request_template, producer, arg, length);
+
+    if (status != HTTPSuccess) {
+        LogError(("slack_client_upload_file: upload status != HTTPSuccess, %d", status));
+        return -1;
+    }
+
+    if (client->https.response.statusCode != 200) {
+        LogError(("slack_client_upload_file: upload client->https.response.statusCode = %d", client->https.response.statusCode));
+        return -1;
+    }
+
+    char body[128];
+    json_writer_t writer;
+
+    json_writer_init(&writer, body, sizeof(body));
+    json_writer_begin_object(&writer);
+    json_writer_key(&writer, "files");
+    json_writer_begin_array(&writer);
+    json_writer_begin_object(&writer);
+    json_writer_key(&writer, "id");
+    json_writer_string(&writer, file_id);
+    json_writer_end_object(&writer);
+    json_writer_end_array(&writer);
+    json_writer_key(&writer, "channel_id");
+    json_writer_string(&writer, channel_id);
+    json_writer_end_object(&writer);
+
+    if (json_writer_finish(&writer) < 0) {
+        LogError(("slack_client_upload_file: channel_id %s is too long!", channel_id));
+        return -1;
+    }
+
+    if (slack_client_bot_request_template(client, &request_template, "/api/files.completeUploadExternal", "application/json;charset=utf8") != 0) {
+        return -1;
+    }
+
+    return slack_client_api_call(client, "slack_client_upload_file", SLACK_CLIENT_TIER_4, &request_template, body, fields, 2);
+}
+
+// uploads a file of length bytes with files.getUploadURLExternal and
+// files.completeUploadExternal, the file is read from the producer while it
+// is sent, so it can be much larger than RAM
+int slack_client_upload_file(
+    slack_client_t* client,
+    const char* channel_id,
+    const char* filename,
+    size_t length,
+    https_body_producer_t producer,
+    void* arg
+)
+{
+    xSemaphoreTake(client->web_api_lock, portMAX_DELAY);
+    int result = slack_client_send_file(client, channel_id, filename, length, producer, arg);
+    xSemaphoreGive(client->web_api_lock);
+
+    return result;
 }
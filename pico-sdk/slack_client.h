@@ -9,19 +9,147 @@
 
 #include <cJSON.h>
 
+#include <FreeRTOS.h>
+#include <queue.h>
+#include <semphr.h>
+#include <task.h>
+
 #include "https_client.h"
+#include "json_scanner.h"
+#include "rate_limiter.h"
 #include "wss_client.h"
 
+#ifndef SLACK_CLIENT_ENVELOPE_ID_MAX_LEN
+#define SLACK_CLIENT_ENVELOPE_ID_MAX_LEN 64
+#endif
+
+// acknowledgements without a payload are written into a buffer of this size on the stack
+#ifndef SLACK_CLIENT_ACK_MAX_LEN
+#define SLACK_CLIENT_ACK_MAX_LEN (SLACK_CLIENT_ENVELOPE_ID_MAX_LEN + 32)
+#endif
+
+#ifndef SLACK_CLIENT_PIPELINE_MAX_REQUESTS
+#define SLACK_CLIENT_PIPELINE_MAX_REQUESTS 4
+#endif
+
+#ifndef SLACK_CLIENT_SEND_QUEUE_LEN
+#define SLACK_CLIENT_SEND_QUEUE_LEN 4
+#endif
+
+#ifndef SLACK_CLIENT_SEND_TEXT_MAX_LEN
+#define SLACK_CLIENT_SEND_TEXT_MAX_LEN 256
+#endif
+
+#ifndef SLACK_CLIENT_SEND_CHANNEL_MAX_LEN
+#define SLACK_CLIENT_SEND_CHANNEL_MAX_LEN 32
+#endif
+
+#ifndef SLACK_CLIENT_SENDER_STACK_SIZE
+#define SLACK_CLIENT_SENDER_STACK_SIZE 2048
+#endif
+
+#ifndef SLACK_CLIENT_SENDER_PRIORITY
+#define SLACK_CLIENT_SENDER_PRIORITY (tskIDLE_PRIORITY + 1UL)
+#endif
+
+// times a queued message is sent again after Slack answered 429 Too Many Requests
+#ifndef SLACK_CLIENT_SEND_MAX_RETRIES
+#define SLACK_CLIENT_SEND_MAX_RETRIES 3
+#endif
+
+// chat.postMessage allows about one message a second per channel, with short bursts
+#ifndef SLACK_CLIENT_CHANNEL_PER_MINUTE
+#define SLACK_CLIENT_CHANNEL_PER_MINUTE 60
+#endif
+
+#ifndef SLACK_CLIENT_CHANNEL_BURST
+#define SLACK_CLIENT_CHANNEL_BURST 3
+#endif
+
+// channels whose rate limit is tracked, an idle or else the oldest one is replaced
+#ifndef SLACK_CLIENT_RATE_LIMIT_CHANNELS
+#define SLACK_CLIENT_RATE_LIMIT_CHANNELS 4
+#endif
+
+// Web API rate limit tiers of the methods used, https://api.slack.com/docs/rate-limits
+typedef enum {
+    SLACK_CLIENT_TIER_1,
+    SLACK_CLIENT_TIER_4,
+    SLACK_CLIENT_TIER_POST_MESSAGE,
+    SLACK_CLIENT_TIER_COUNT
+} slack_client_tier_t;
+
+// called from the sender task once a queued message was posted, result is 0 or -1
+typedef void (*slack_client_sent_t)(void* arg, int result);
+
+typedef struct {
+    char text[SLACK_CLIENT_SEND_TEXT_MAX_LEN];
+    char channel[SLACK_CLIENT_SEND_CHANNEL_MAX_LEN];
+    slack_client_sent_t sent;
+    void* sent_arg;
+    TickType_t queued;
+    uint8_t retries;
+    uint8_t delayed;
+} slack_client_send_request_t;
+
+typedef struct {
+    char channel[SLACK_CLIENT_SEND_CHANNEL_MAX_LEN];
+    rate_limiter_t limiter;
+} slack_client_channel_limit_t;
+
+typedef struct {
+    uint32_t queued;
+    uint32_t rejected;
+    uint32_t depth;
+    uint32_t peak_depth;
+    uint32_t sent;
+    uint32_t failed;
+    uint32_t throttled;
+    uint32_t delayed;
+    uint32_t delay_ms;
+    uint32_t max_delay_ms;
+} slack_client_send_stats_t;
+
 typedef struct {
+    tls_config_t* tls_config;
     const char* bot_token;
     const char* app_token;
     https_client_t https;
     wss_client_t wss;
-    char* buf;
-    size_t buf_len;
+    int wss_connecting;
+    char wss_host[TLS_CLIENT_HOST_MAX_LEN];
+    char wss_path[256];
+
+    // envelopes are acknowledged in slack_client_poll, before they are parsed
+    int ack_first;
+    char acked_envelope_id[SLACK_CLIENT_ENVELOPE_ID_MAX_LEN];
+
+    // events too large for the receive buffer are scanned as they stream in
+    json_scanner_t large_message;
+    json_scanner_field_t large_envelope_id;
+    char large_envelope_id_value[SLACK_CLIENT_ENVELOPE_ID_MAX_LEN];
+    int large_acked;
+
+    json_scanner_t response;
+    https_request_template_t connections_open_request;
+    https_request_template_t post_message_request;
+    SemaphoreHandle_t web_api_lock;
+    QueueHandle_t send_queue;
+    TaskHandle_t sender;
+
+    // taken off the queue by the sender task, waiting for their rate limits
+    slack_client_send_request_t held[SLACK_CLIENT_SEND_QUEUE_LEN];
+    size_t num_held;
+
+    rate_limiter_t tier_limits[SLACK_CLIENT_TIER_COUNT];
+    slack_client_channel_limit_t channel_limits[SLACK_CLIENT_RATE_LIMIT_CHANNELS];
+    int channel_limit_next;
+    slack_client_send_stats_t send_stats;
 } slack_client_t;
 
-int slack_client_init(slack_client_t* client, const char* bot_token, const char* app_token, char* buf, size_t buf_len);
+int slack_client_init(slack_client_t* client, tls_config_t* tls_config, const char* bot_token, const char* app_token);
+
+void slack_client_set_ack_first(slack_client_t* client, int ack_first);
 
 cJSON* slack_client_poll(slack_client_t* client);
 
@@ -29,4 +157,19 @@ int slack_client_acknowledge_event(slack_client_t* client, const char* envelope_
 
 int slack_client_post_message(slack_client_t* client, const char* text, const char* channel);
 
+int slack_client_post_message_async(slack_client_t* client, const char* text, const char* channel, slack_client_sent_t sent, void* sent_arg);
+
+void slack_client_get_send_stats(slack_client_t* client, slack_client_send_stats_t* stats);
+
+int slack_client_post_messages(slack_client_t* client, const char* texts[], size_t num_texts, const char* channel);
+
+int slack_client_upload_file(
+    slack_client_t* client,
+    const char* channel_id,
+    const char* filename,
+    size_t length,
+    https_body_producer_t producer,
+    void* arg
+);
+
 #endif
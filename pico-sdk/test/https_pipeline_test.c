@@ -0,0 +1,206 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "buf_pool.h"
+#include "https_client.h"
+
+#define CHECK(condition) do { if (!(condition)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); return -1; } } while (0)
+
+static const char response[] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+
+// scripted connection, it answers up to max_answers requests and then reads
+// as closed, writes fail once max_writes have gone through, the limits are
+// taken from next_max_answers and next_max_writes when it connects
+static struct {
+    int connects;
+    int requests;
+    int max_answers;
+    int max_writes;
+    int writes;
+    size_t read_pos;
+} conn;
+
+static int next_max_answers;
+static int next_max_writes;
+
+int tls_client_init(tls_client_t* client, tls_config_t* config)
+{
+    client->sock = -1;
+
+    return 0;
+}
+
+int tls_client_connect(tls_client_t* client, const char* host, const char* port)
+{
+    client->sock = 1;
+
+    conn.connects++;
+    conn.requests = 0;
+    conn.max_answers = next_max_answers;
+    conn.max_writes = next_max_writes;
+    conn.writes = 0;
+    conn.read_pos = 0;
+
+    // only the first connection of a test fails its writes
+    next_max_writes = -1;
+
+    return 0;
+}
+
+int tls_client_connected(tls_client_t* client)
+{
+    return client->sock >= 0;
+}
+
+int tls_client_check_idle(tls_client_t* client)
+{
+    return 0;
+}
+
+int tls_client_close(tls_client_t* client)
+{
+    client->sock = -1;
+
+    return 0;
+}
+
+int tls_client_write(tls_client_t* client, const uint8_t* data, size_t len)
+{
+    if (conn.writes == conn.max_writes) {
+        return -1;
+    }
+
+    conn.writes++;
+
+    if (len >= 5 && memcmp(data, "POST ", 5) == 0) {
+        conn.requests++;
+    }
+
+    return len;
+}
+
+int tls_client_read(tls_client_t* client, uint8_t* data, size_t len)
+{
+    int answers = (conn.requests < conn.max_answers) ? conn.requests : conn.max_answers;
+    size_t end = answers * (sizeof(response) - 1);
+    size_t n = end - conn.read_pos;
+
+    if (n > len) {
+        n = len;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        data[i] = response[(conn.read_pos + i) % (sizeof(response) - 1)];
+    }
+
+    conn.read_pos += n;
+
+    return n;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return 0;
+}
+
+void vTaskSuspendAll(void)
+{
+}
+
+BaseType_t xTaskResumeAll(void)
+{
+    return pdFALSE;
+}
+
+uint64_t time_us_64(void)
+{
+    return 0;
+}
+
+static int consume(void* arg, const uint8_t* data, size_t len)
+{
+    return 0;
+}
+
+static void requests_init(https_pipeline_request_t* requests, size_t num_requests, const https_request_template_t* request_template)
+{
+    for (size_t i = 0; i < num_requests; i++) {
+        requests[i].request_template = request_template;
+        requests[i].body = "{}";
+        requests[i].body_len = 2;
+        requests[i].body_consumer = consume;
+        requests[i].body_consumer_arg = NULL;
+    }
+}
+
+// the connection closes after the requests went out and before all responses
+// came back, the written requests must not be sent a second time
+static int test_dropped_after_write(https_client_t* client, const https_request_template_t* request_template)
+{
+    https_pipeline_request_t requests[3];
+
+    requests_init(requests, 3, request_template);
+    conn.connects = 0;
+    next_max_answers = 1;
+    next_max_writes = -1;
+
+    CHECK(https_client_pipeline(client, requests, 3) == HTTPNoResponse);
+    CHECK(conn.connects == 1);
+    CHECK(conn.requests == 3);
+    CHECK(requests[0].status == HTTPSuccess && requests[0].status_code == 200);
+    CHECK(requests[1].status == HTTPNoResponse && requests[1].written);
+    CHECK(requests[2].status == HTTPNoResponse && requests[2].written);
+
+    return 0;
+}
+
+// a write fails partway through, the requests that did not go out are sent
+// on a new connection and the ones that did are answered on the first
+static int test_write_failed(https_client_t* client, const https_request_template_t* request_template)
+{
+    https_pipeline_request_t requests[3];
+
+    requests_init(requests, 3, request_template);
+    conn.connects = 0;
+    next_max_answers = 3;
+    // the headers and body of the first request and the headers of the second
+    next_max_writes = 3;
+
+    CHECK(https_client_pipeline(client, requests, 3) == HTTPSuccess);
+    CHECK(conn.connects == 2);
+    CHECK(conn.requests == 2);
+
+    for (int i = 0; i < 3; i++) {
+        CHECK(requests[i].status == HTTPSuccess && requests[i].status_code == 200 && requests[i].written);
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    https_client_t client;
+    https_request_template_t request_template;
+
+    if (buf_pool_init() != 0 || https_client_init(&client, NULL) != 0) {
+        return 1;
+    }
+
+    if (https_client_template_init(&client, &request_template, "POST", "slack.com", "/api/chat.postMessage", NULL, 0) != 0) {
+        return 1;
+    }
+
+    if (test_dropped_after_write(&client, &request_template) != 0 ||
+        test_write_failed(&client, &request_template) != 0) {
+        return 1;
+    }
+
+    printf("https_pipeline_test: passed\n");
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+// stands in for the lwIP DNS API in host tests
+
+#ifndef __TEST_LWIP_DNS_H__
+#define __TEST_LWIP_DNS_H__
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t addr;
+} ip_addr_t;
+
+#endif
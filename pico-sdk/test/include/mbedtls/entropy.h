@@ -0,0 +1,15 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+// stands in for the mbedTLS entropy API in host tests
+
+#ifndef __TEST_MBEDTLS_ENTROPY_H__
+#define __TEST_MBEDTLS_ENTROPY_H__
+
+typedef struct {
+    int unused;
+} mbedtls_entropy_context;
+
+#endif
@@ -0,0 +1,26 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+// stands in for the mbedTLS SSL API in host tests, only what tls_client.h and https_client.c use
+
+#ifndef __TEST_MBEDTLS_SSL_H__
+#define __TEST_MBEDTLS_SSL_H__
+
+#define MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY -0x7880
+#define MBEDTLS_SSL_MAX_FRAG_LEN_2048 3
+
+typedef struct {
+    int unused;
+} mbedtls_ssl_context;
+
+typedef struct {
+    int unused;
+} mbedtls_ssl_config;
+
+typedef struct {
+    int unused;
+} mbedtls_x509_crt;
+
+#endif
@@ -0,0 +1,15 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+// stands in for the Pico SDK time API in host tests, the test provides the function
+
+#ifndef __TEST_PICO_TIME_H__
+#define __TEST_PICO_TIME_H__
+
+#include <stdint.h>
+
+uint64_t time_us_64(void);
+
+#endif
@@ -0,0 +1,21 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+// stands in for the FreeRTOS task API in host tests, the test provides the functions
+
+#ifndef __TEST_TASK_H__
+#define __TEST_TASK_H__
+
+#include <FreeRTOS.h>
+
+typedef void* TaskHandle_t;
+
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+void vTaskDelay(TickType_t ticks);
+void vTaskSuspendAll(void);
+BaseType_t xTaskResumeAll(void);
+
+#endif
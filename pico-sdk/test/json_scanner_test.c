@@ -0,0 +1,77 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "json_scanner.h"
+
+#define CHECK(condition) do { if (!(condition)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); return -1; } } while (0)
+
+// feeds the document chunk bytes at a time, returns what the last feed returned
+static int scan(const char* doc, size_t chunk, char* text, size_t text_len)
+{
+    json_scanner_field_t field = { "text", text, text_len };
+    json_scanner_t scanner;
+    size_t len = strlen(doc);
+
+    json_scanner_init(&scanner, &field, 1);
+
+    for (size_t offset = 0; offset < len; offset += chunk) {
+        size_t n = (len - offset < chunk) ? len - offset : chunk;
+
+        if (json_scanner_feed(&scanner, (const uint8_t*)&doc[offset], n) != 0) {
+            return -1;
+        }
+    }
+
+    return (json_scanner_done(&scanner) && field.complete) ? 0 : -1;
+}
+
+// a surrogate pair is one 4-byte UTF-8 sequence, also when split across feeds
+static int test_emoji(void)
+{
+    static const char doc[] = "{\"text\":\"hi \\uD83D\\uDE00 \\u00e9\\u20AC\"}";
+    static const char expected[] = "hi \xF0\x9F\x98\x80 \xC3\xA9\xE2\x82\xAC";
+    char text[32];
+
+    for (size_t chunk = 1; chunk <= sizeof(doc) - 1; chunk++) {
+        CHECK(scan(doc, chunk, text, sizeof(text)) == 0);
+        CHECK(strcmp(text, expected) == 0);
+    }
+
+    return 0;
+}
+
+static int test_unpaired_surrogates(void)
+{
+    char text[32];
+
+    // high surrogate at the end of the string
+    CHECK(scan("{\"text\":\"\\uD83D\"}", 1, text, sizeof(text)) != 0);
+    // high surrogate followed by a plain character
+    CHECK(scan("{\"text\":\"\\uD83Dx\"}", 1, text, sizeof(text)) != 0);
+    // high surrogate followed by another escape
+    CHECK(scan("{\"text\":\"\\uD83D\\n\"}", 1, text, sizeof(text)) != 0);
+    // high surrogate followed by a code point that is not a low surrogate
+    CHECK(scan("{\"text\":\"\\uD83D\\u0041\"}", 1, text, sizeof(text)) != 0);
+    // two high surrogates
+    CHECK(scan("{\"text\":\"\\uD83D\\uD83D\"}", 1, text, sizeof(text)) != 0);
+    // low surrogate on its own
+    CHECK(scan("{\"text\":\"\\uDE00\"}", 1, text, sizeof(text)) != 0);
+
+    return 0;
+}
+
+int main(void)
+{
+    if (test_emoji() != 0 || test_unpaired_surrogates() != 0) {
+        return 1;
+    }
+
+    printf("json_scanner_test: passed\n");
+
+    return 0;
+}
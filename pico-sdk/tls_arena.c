@@ -0,0 +1,245 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <mbedtls/platform.h>
+
+#include "logging.h"
+
+#include "tls_arena.h"
+
+#define TLS_ARENA_ALIGNMENT 8
+#define TLS_ARENA_ALIGN(x) (((x) + (TLS_ARENA_ALIGNMENT - 1)) & ~(TLS_ARENA_ALIGNMENT - 1))
+
+// header in front of every block, next is only used while the block is free
+typedef struct tls_arena_block {
+    struct tls_arena_block* next;
+    size_t size;
+} tls_arena_block_t;
+
+#define TLS_ARENA_HEADER_SIZE TLS_ARENA_ALIGN(sizeof(tls_arena_block_t))
+#define TLS_ARENA_MIN_BLOCK_SIZE (TLS_ARENA_HEADER_SIZE + TLS_ARENA_ALIGNMENT)
+
+static uint8_t arena[TLS_ARENA_SIZE] __attribute__((aligned(TLS_ARENA_ALIGNMENT)));
+
+// free blocks, sorted by address so neighbours can be merged on free
+static tls_arena_block_t* free_list = NULL;
+static tls_arena_stats_t stats;
+static tls_arena_meter_t* meters[TLS_ARENA_MAX_METERS];
+
+// called with the scheduler suspended
+static tls_arena_meter_t* tls_arena_find_meter(void)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+
+    for (int i = 0; i < TLS_ARENA_MAX_METERS; i++) {
+        if (meters[i] != NULL && meters[i]->entered && meters[i]->task == task) {
+            return meters[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void* tls_arena_calloc(size_t n, size_t size)
+{
+    if (n == 0 || size == 0) {
+        return NULL;
+    }
+
+    if (size > (SIZE_MAX - TLS_ARENA_MIN_BLOCK_SIZE) / n) {
+        stats.failed++;
+        return NULL;
+    }
+
+    size_t needed = TLS_ARENA_HEADER_SIZE + TLS_ARENA_ALIGN(n * size);
+    tls_arena_block_t* prev = NULL;
+    tls_arena_block_t* block;
+
+    vTaskSuspendAll();
+
+    // first fit
+    for (block = free_list; block != NULL; prev = block, block = block->next) {
+        if (block->size >= needed) {
+            break;
+        }
+    }
+
+    if (block == NULL) {
+        stats.failed++;
+        xTaskResumeAll();
+
+        LogWarn(("tls_arena_calloc: failed to allocate %u bytes, %u of %u bytes in use", (unsigned)(n * size), (unsigned)stats.used, (unsigned)stats.size));
+        return NULL;
+    }
+
+    tls_arena_block_t* next = block->next;
+
+    if (block->size - needed >= TLS_ARENA_MIN_BLOCK_SIZE) {
+        // split, the remainder stays on the free list in place of this block
+        next = (tls_arena_block_t*)((uint8_t*)block + needed);
+        next->size = block->size - needed;
+        next->next = block->next;
+
+        block->size = needed;
+    }
+
+    if (prev == NULL) {
+        free_list = next;
+    } else {
+        prev->next = next;
+    }
+
+    stats.used += block->size;
+    if (stats.used > stats.peak) {
+        stats.peak = stats.used;
+    }
+
+    tls_arena_meter_t* meter = tls_arena_find_meter();
+
+    if (meter != NULL) {
+        meter->used += block->size;
+        if (meter->used > meter->peak) {
+            meter->peak = meter->used;
+        }
+    }
+
+    xTaskResumeAll();
+
+    void* ptr = (uint8_t*)block + TLS_ARENA_HEADER_SIZE;
+
+    memset(ptr, 0x00, block->size - TLS_ARENA_HEADER_SIZE);
+
+    return ptr;
+}
+
+static void tls_arena_free(void* ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    tls_arena_block_t* block = (tls_arena_block_t*)((uint8_t*)ptr - TLS_ARENA_HEADER_SIZE);
+    tls_arena_block_t* prev = NULL;
+    tls_arena_block_t* next;
+
+    vTaskSuspendAll();
+
+    stats.used -= block->size;
+
+    tls_arena_meter_t* meter = tls_arena_find_meter();
+
+    // blocks allocated before the meter started are not counted
+    if (meter != NULL) {
+        meter->used = (meter->used > block->size) ? meter->used - block->size : 0;
+    }
+
+    for (next = free_list; next != NULL && next < block; prev = next, next = next->next) {
+    }
+
+    if (next != NULL && (uint8_t*)block + block->size == (uint8_t*)next) {
+        block->size += next->size;
+        next = next->next;
+    }
+    block->next = next;
+
+    if (prev == NULL) {
+        free_list = block;
+    } else if ((uint8_t*)prev + prev->size == (uint8_t*)block) {
+        prev->size += block->size;
+        prev->next = block->next;
+    } else {
+        prev->next = block;
+    }
+
+    xTaskResumeAll();
+}
+
+int tls_arena_init(void)
+{
+    free_list = (tls_arena_block_t*)arena;
+    free_list->next = NULL;
+    free_list->size = sizeof(arena);
+
+    memset(&stats, 0x00, sizeof(stats));
+    stats.size = sizeof(arena);
+
+    if (mbedtls_platform_set_calloc_free(tls_arena_calloc, tls_arena_free) != 0) {
+        LogError(("tls_arena_init: mbedtls_platform_set_calloc_free failed!"));
+        return -1;
+    }
+
+    return 0;
+}
+
+int tls_arena_meter_start(tls_arena_meter_t* meter, size_t used)
+{
+    int result = -1;
+
+    meter->task = NULL;
+    meter->entered = 0;
+    meter->used = used;
+    meter->peak = used;
+
+    vTaskSuspendAll();
+
+    for (int i = 0; i < TLS_ARENA_MAX_METERS; i++) {
+        if (meters[i] == meter) {
+            result = 0;
+            break;
+        }
+    }
+
+    for (int i = 0; i < TLS_ARENA_MAX_METERS && result != 0; i++) {
+        if (meters[i] == NULL) {
+            meters[i] = meter;
+            result = 0;
+        }
+    }
+
+    xTaskResumeAll();
+
+    return result;
+}
+
+void tls_arena_meter_stop(tls_arena_meter_t* meter)
+{
+    vTaskSuspendAll();
+
+    for (int i = 0; i < TLS_ARENA_MAX_METERS; i++) {
+        if (meters[i] == meter) {
+            meters[i] = NULL;
+        }
+    }
+
+    xTaskResumeAll();
+}
+
+void tls_arena_meter_enter(tls_arena_meter_t* meter)
+{
+    vTaskSuspendAll();
+    meter->task = xTaskGetCurrentTaskHandle();
+    meter->entered = 1;
+    xTaskResumeAll();
+}
+
+void tls_arena_meter_leave(tls_arena_meter_t* meter)
+{
+    vTaskSuspendAll();
+    meter->entered = 0;
+    xTaskResumeAll();
+}
+
+void tls_arena_get_stats(tls_arena_stats_t* stats_out)
+{
+    vTaskSuspendAll();
+    *stats_out = stats;
+    xTaskResumeAll();
+}
@@ -0,0 +1,57 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+
+#ifndef __TLS_ARENA_H__
+#define __TLS_ARENA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+// sized for the wss connection, one pooled https connection and one handshake in flight
+#ifndef TLS_ARENA_SIZE
+#define TLS_ARENA_SIZE (48 * 1024)
+#endif
+
+// connections that can have a meter running at the same time
+#ifndef TLS_ARENA_MAX_METERS
+#define TLS_ARENA_MAX_METERS 4
+#endif
+
+typedef struct {
+    size_t size;
+    size_t used;
+    size_t peak;
+    uint32_t failed;
+} tls_arena_stats_t;
+
+// counts what one connection allocates and frees while its task has the meter
+// entered, so connects in flight at the same time, on one task or several,
+// each see their own peak
+typedef struct {
+    TaskHandle_t task;
+    int entered;
+    size_t used;
+    size_t peak;
+} tls_arena_meter_t;
+
+int tls_arena_init(void);
+
+void tls_arena_get_stats(tls_arena_stats_t* stats);
+
+// starts counting from used bytes the task already holds, returns -1 if all meters are running
+int tls_arena_meter_start(tls_arena_meter_t* meter, size_t used);
+
+void tls_arena_meter_stop(tls_arena_meter_t* meter);
+
+// charges the calling task's allocations to the meter until tls_arena_meter_leave
+void tls_arena_meter_enter(tls_arena_meter_t* meter);
+
+void tls_arena_meter_leave(tls_arena_meter_t* meter);
+
+#endif
@@ -4,14 +4,52 @@
 //
 
 
+#include <stdlib.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <lwip/dns.h>
 #include <lwip/ip4_addr.h>
-#include <lwip/netdb.h>
 #include <lwip/sockets.h>
 
+#include <mbedtls/ssl_internal.h>
+
+#include "pico/cyw43_arch.h"
+
+#include "dns_cache.h"
 #include "logging.h"
+#include "tls_arena.h"
 
 #include "tls_client.h"
 
+typedef struct {
+    char host[TLS_CLIENT_HOST_MAX_LEN];
+    mbedtls_ssl_session session;
+    int valid;
+} tls_session_cache_entry_t;
+
+// ECDHE with AES-128-GCM only, so the handshake needs a single X25519 or P-256
+// key exchange and records are protected with the cheapest AEAD we have
+static const int fast_ciphersuites[] = {
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    0
+};
+
+static const mbedtls_ecp_group_id fast_curves[] = {
+    MBEDTLS_ECP_DP_CURVE25519,
+    MBEDTLS_ECP_DP_SECP256R1,
+    MBEDTLS_ECP_DP_SECP384R1, // only for certificate signatures
+    MBEDTLS_ECP_DP_NONE
+};
+
+// shared by connections set up from different tasks
+static tls_session_cache_entry_t session_cache[TLS_CLIENT_SESSION_CACHE_SIZE];
+static int session_cache_next = 0;
+static SemaphoreHandle_t session_cache_lock;
+static tls_client_session_stats_t session_stats;
+
 static int mbedtls_ssl_lwip_send(void* ctx, const unsigned char* buf, size_t len)
 {
     int sock = (int)ctx;
@@ -40,74 +78,520 @@ static int mbedtls_ssl_lwip_recv(void* ctx, unsigned char* buf, size_t len)
     return result;
 }
 
-int tls_client_init(tls_client_t* client, const unsigned char* root_ca, size_t root_ca_len)
+static tls_session_cache_entry_t* tls_session_cache_find(const char* host)
 {
-    mbedtls_ssl_init(&client->ctx);
-    mbedtls_ssl_config_init(&client->conf);
-    mbedtls_x509_crt_init(&client->cacert);
-    mbedtls_ctr_drbg_init(&client->ctr_drbg);
-    mbedtls_entropy_init(&client->entropy);
+    for (int i = 0; i < TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+        if (session_cache[i].valid && strcmp(session_cache[i].host, host) == 0) {
+            return &session_cache[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void tls_session_cache_invalidate(tls_session_cache_entry_t* entry)
+{
+    mbedtls_ssl_session_free(&entry->session);
+    entry->valid = 0;
+}
+
+static void tls_session_cache_store(const char* host, const mbedtls_ssl_context* ctx)
+{
+    if (strlen(host) >= TLS_CLIENT_HOST_MAX_LEN) {
+        return;
+    }
+
+    tls_session_cache_entry_t* entry = tls_session_cache_find(host);
+
+    if (entry == NULL) {
+        // round robin eviction, the cache only ever holds a few hosts
+        entry = &session_cache[session_cache_next];
+        session_cache_next = (session_cache_next + 1) % TLS_CLIENT_SESSION_CACHE_SIZE;
+    }
+
+    tls_session_cache_invalidate(entry);
+    mbedtls_ssl_session_init(&entry->session);
+
+    if (mbedtls_ssl_get_session(ctx, &entry->session) != 0) {
+        LogWarn(("tls_session_cache_store: mbedtls_ssl_get_session failed!"));
+        mbedtls_ssl_session_free(&entry->session);
+        return;
+    }
 
-    if (mbedtls_ctr_drbg_seed(&client->ctr_drbg, mbedtls_entropy_func, &client->entropy, NULL, 0) != 0 ) {
-        LogError(("tls_client_init: mbedtls_ctr_drbg_seed failed!"));
+    strcpy(entry->host, host);
+    entry->valid = 1;
+}
+
+static uint32_t tls_client_phase_ms(tls_client_t* client)
+{
+    return (xTaskGetTickCount() - client->phase_start) * portTICK_PERIOD_MS;
+}
+
+static void tls_client_enter_state(tls_client_t* client, tls_client_state_t state)
+{
+    client->state = state;
+    client->phase_start = xTaskGetTickCount();
+}
+
+static int tls_client_fail(tls_client_t* client)
+{
+    tls_arena_meter_stop(&client->arena_meter);
+
+    if (client->sock != -1) {
+        close(client->sock);
+        client->sock = -1;
+    }
+
+    client->state = TLS_CLIENT_STATE_FAILED;
+
+    return -1;
+}
+
+// runs in the lwIP thread
+static void tls_client_dns_found(const char* name, const ip_addr_t* ipaddr, void* arg)
+{
+    tls_client_t* client = (tls_client_t*)arg;
+
+    // ignore late answers for a lookup that already timed out
+    if (client->state != TLS_CLIENT_STATE_RESOLVING || strcmp(name, client->host) != 0) {
+        return;
+    }
+
+    if (ipaddr != NULL) {
+        ip_addr_copy(client->addr, *ipaddr);
+        client->resolve_result = 1;
+    } else {
+        client->resolve_result = -1;
+    }
+}
+
+static int tls_client_start_tcp(tls_client_t* client)
+{
+    struct sockaddr_in addr;
+
+    memset(&addr, 0x00, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(client->port);
+    addr.sin_addr.s_addr = ip4_addr_get_u32(ip_2_ip4(&client->addr));
+
+    client->sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (client->sock == -1) {
+        LogError(("tls_client_connect: socket failed, errno = %d", errno));
         return -1;
     }
 
-    if (mbedtls_x509_crt_parse_der_nocopy(&client->cacert, root_ca, root_ca_len) != 0) {
-        LogError(("tls_client_init: mbedtls_x509_crt_parse_der_nocopy failed!"));
+    int fiobio = 1;
+    lwip_ioctl(client->sock, FIONBIO, &fiobio);
+
+    if (connect(client->sock, (struct sockaddr*)&addr, sizeof(addr)) != 0 && errno != EINPROGRESS) {
+        LogError(("tls_client_connect: connect failed, errno = %d", errno));
         return -1;
     }
 
-    if(mbedtls_ssl_config_defaults(&client->conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
-        LogError(("tls_client_init: mbedtls_ssl_config_defaults failed!"));
+    tls_client_enter_state(client, TLS_CLIENT_STATE_CONNECTING);
+
+    return 0;
+}
+
+// returns 1 once the TCP connection is up, 0 while it is in progress
+static int tls_client_poll_tcp(tls_client_t* client)
+{
+    fd_set write_fds;
+    struct timeval timeout = { 0, 0 };
+
+    FD_ZERO(&write_fds);
+    FD_SET(client->sock, &write_fds);
+
+    int result = lwip_select(client->sock + 1, NULL, &write_fds, NULL, &timeout);
+
+    if (result == 0) {
+        return 0;
+    } else if (result < 0) {
         return -1;
     }
 
-    mbedtls_ssl_conf_authmode(&client->conf, MBEDTLS_SSL_VERIFY_REQUIRED );
-    mbedtls_ssl_conf_ca_chain(&client->conf, &client->cacert, NULL);
-    mbedtls_ssl_conf_rng(&client->conf, mbedtls_ctr_drbg_random, &client->ctr_drbg);
-    mbedtls_ssl_setup(&client->ctx, &client->conf);
+    int error = 0;
+    socklen_t error_len = sizeof(error);
 
-    client->sock = -1;
+    if (lwip_getsockopt(client->sock, SOL_SOCKET, SO_ERROR, &error, &error_len) != 0 || error != 0) {
+        LogError(("tls_client_connect: connect to %s failed, error = %d", client->host, error));
+        return -1;
+    }
+
+    return 1;
+}
+
+static int tls_client_start_handshake(tls_client_t* client)
+{
+    if (mbedtls_ssl_set_hostname(&client->ctx, client->host) != 0) {
+        LogError(("tls_client_connect: mbedtls_ssl_set_hostname failed!"));
+        return -1;
+    }
+
+    mbedtls_ssl_set_bio(&client->ctx, (void*)client->sock, mbedtls_ssl_lwip_send, mbedtls_ssl_lwip_recv, NULL);
+
+    client->resumed = 0;
+
+    xSemaphoreTake(session_cache_lock, portMAX_DELAY);
+
+    tls_session_cache_entry_t* entry = tls_session_cache_find(client->host);
+
+    // session_offered is -1 when retrying after a failed resumption
+    if (client->session_offered == 0 && entry != NULL) {
+        tls_arena_meter_enter(&client->arena_meter);
+
+        if (mbedtls_ssl_set_session(&client->ctx, &entry->session) == 0) {
+            client->session_offered = 1;
+        }
+
+        tls_arena_meter_leave(&client->arena_meter);
+    }
+
+    xSemaphoreGive(session_cache_lock);
+
+    tls_client_enter_state(client, TLS_CLIENT_STATE_HANDSHAKING);
 
     return 0;
 }
 
-int tls_client_connect(tls_client_t* client, const char* host, const char* port)
+// returns 1 once the handshake is over, 0 while it is waiting for the network
+static int tls_client_poll_handshake(tls_client_t* client)
+{
+    while (client->ctx.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        // another connect on this task may step its handshake in between
+        tls_arena_meter_enter(&client->arena_meter);
+        int result = mbedtls_ssl_handshake_step(&client->ctx);
+        tls_arena_meter_leave(&client->arena_meter);
+
+        if (result == MBEDTLS_ERR_SSL_WANT_READ || result == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            return 0;
+        } else if (result != 0) {
+            LogError(("tls_client_connect: mbedtls_ssl_handshake_step failed, result = -0x%x", -result));
+            return -1;
+        }
+
+        // the handshake parameters are freed once the handshake is over,
+        // so check if the server accepted the session while they are around
+        if (client->ctx.handshake != NULL && client->ctx.handshake->resume) {
+            client->resumed = 1;
+        }
+    }
+
+    return 1;
+}
+
+// handshakes, CBC record IVs and WebSocket mask keys of every connection use this
+int tls_config_random(void* arg, unsigned char* output, size_t output_len)
 {
-    struct addrinfo hints, *res;
+    tls_config_t* config = (tls_config_t*)arg;
 
-    memset(&hints, 0, sizeof hints);
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
+    xSemaphoreTake(config->drbg_lock, portMAX_DELAY);
+    int result = mbedtls_ctr_drbg_random(&config->ctr_drbg, output, output_len);
+    xSemaphoreGive(config->drbg_lock);
 
-    if (getaddrinfo(host, port, &hints, &res) != 0) {
-        LogError(("tls_client_connect: getaddrinfo failed!"));
+    return result;
+}
+
+int tls_config_init(tls_config_t* config, const unsigned char* root_ca, size_t root_ca_len)
+{
+    mbedtls_ssl_config_init(&config->conf);
+    mbedtls_x509_crt_init(&config->cacert);
+    mbedtls_ctr_drbg_init(&config->ctr_drbg);
+    mbedtls_entropy_init(&config->entropy);
+
+    config->drbg_lock = xSemaphoreCreateMutex();
+    if (config->drbg_lock == NULL) {
+        LogError(("tls_config_init: xSemaphoreCreateMutex failed!"));
         return -1;
     }
 
-    client->sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-    if (client->sock == -1) {
-        LogError(("tls_client_connect: socket failed, errno = %d"));
+    if (session_cache_lock == NULL) {
+        session_cache_lock = xSemaphoreCreateMutex();
+        if (session_cache_lock == NULL) {
+            LogError(("tls_config_init: xSemaphoreCreateMutex failed!"));
+            return -1;
+        }
+    }
+
+    if (mbedtls_ctr_drbg_seed(&config->ctr_drbg, mbedtls_entropy_func, &config->entropy, NULL, 0) != 0 ) {
+        LogError(("tls_config_init: mbedtls_ctr_drbg_seed failed!"));
         return -1;
     }
 
-    if (connect(client->sock, res->ai_addr, res->ai_addrlen) != 0) {
-        LogError(("tls_client_connect: connect failed!"));
+    if (mbedtls_x509_crt_parse_der_nocopy(&config->cacert, root_ca, root_ca_len) != 0) {
+        LogError(("tls_config_init: mbedtls_x509_crt_parse_der_nocopy failed!"));
         return -1;
     }
-    freeaddrinfo(res);
 
-    if (mbedtls_ssl_set_hostname(&client->ctx, host) != 0) {
-        LogError(("tls_client_connect: mbedtls_ssl_set_hostname failed!"));
+    if(mbedtls_ssl_config_defaults(&config->conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+        LogError(("tls_config_init: mbedtls_ssl_config_defaults failed!"));
         return -1;
     }
 
-    mbedtls_ssl_set_bio(&client->ctx, (void*)client->sock, mbedtls_ssl_lwip_send, mbedtls_ssl_lwip_recv, NULL);
+    mbedtls_ssl_conf_authmode(&config->conf, MBEDTLS_SSL_VERIFY_REQUIRED );
+    mbedtls_ssl_conf_ca_chain(&config->conf, &config->cacert, NULL);
+    mbedtls_ssl_conf_rng(&config->conf, tls_config_random, config);
+
+    if (mbedtls_ssl_conf_max_frag_len(&config->conf, TLS_CLIENT_MAX_FRAG_LEN) != 0) {
+        LogError(("tls_config_init: mbedtls_ssl_conf_max_frag_len failed!"));
+        return -1;
+    }
+
+    tls_config_set_profile(config, TLS_CLIENT_PROFILE);
+
+    config->resolve_timeout_ms = TLS_CLIENT_RESOLVE_TIMEOUT_MS;
+    config->connect_timeout_ms = TLS_CLIENT_CONNECT_TIMEOUT_MS;
+    config->handshake_timeout_ms = TLS_CLIENT_HANDSHAKE_TIMEOUT_MS;
+
+    return 0;
+}
+
+void tls_config_set_profile(tls_config_t* config, tls_client_profile_t profile)
+{
+    if (profile == TLS_CLIENT_PROFILE_FAST) {
+        mbedtls_ssl_conf_ciphersuites(&config->conf, fast_ciphersuites);
+        mbedtls_ssl_conf_curves(&config->conf, fast_curves);
+    } else {
+        mbedtls_ssl_conf_ciphersuites(&config->conf, mbedtls_ssl_list_ciphersuites());
+        mbedtls_ssl_conf_curves(&config->conf, mbedtls_ecp_grp_id_list());
+    }
+}
+
+int tls_client_init(tls_client_t* client, tls_config_t* config)
+{
+    client->config = config;
+    client->sock = -1;
+    client->state = TLS_CLIENT_STATE_IDLE;
+
+    mbedtls_ssl_init(&client->ctx);
+
+    if (mbedtls_ssl_setup(&client->ctx, &config->conf) != 0) {
+        LogError(("tls_client_init: mbedtls_ssl_setup failed!"));
+        return -1;
+    }
 
     return 0;
 }
 
+int tls_client_connect_start(tls_client_t* client, const char* host, const char* port)
+{
+    if (strlen(host) >= sizeof(client->host)) {
+        LogError(("tls_client_connect: host name %s is too long!", host));
+        return tls_client_fail(client);
+    }
+
+    strcpy(client->host, host);
+    client->port = atoi(port);
+    client->session_offered = 0;
+    memset(&client->connect_times, 0x00, sizeof(client->connect_times));
+    memset(&client->memory, 0x00, sizeof(client->memory));
+
+    // the I/O buffers were already allocated by tls_client_init, the meter
+    // only counts while this connection's mbedTLS calls are running, so other
+    // connections do not show up in the peak
+    if (tls_arena_meter_start(&client->arena_meter, client->ctx.in_buf_len + client->ctx.out_buf_len) != 0) {
+        LogWarn(("tls_client_connect: no arena meter left, the peak for %s is not measured", client->host));
+    }
+
+    client->resolve_result = 0;
+    tls_client_enter_state(client, TLS_CLIENT_STATE_RESOLVING);
+
+    if (dns_cache_lookup(client->host, &client->addr)) {
+        client->addr_cached = 1;
+        client->resolve_result = 1;
+
+        return 0;
+    }
+
+    client->addr_cached = 0;
+
+    cyw43_arch_lwip_begin();
+    err_t err = dns_gethostbyname(client->host, &client->addr, tls_client_dns_found, client);
+    cyw43_arch_lwip_end();
+
+    if (err == ERR_OK) {
+        // answered from the lwIP DNS table
+        client->resolve_result = 1;
+    } else if (err != ERR_INPROGRESS) {
+        LogError(("tls_client_connect: dns_gethostbyname failed, err = %d", err));
+        return tls_client_fail(client);
+    }
+
+    return 0;
+}
+
+int tls_client_connect_poll(tls_client_t* client)
+{
+    int result;
+
+    switch (client->state) {
+        case TLS_CLIENT_STATE_RESOLVING:
+            if (client->resolve_result < 0) {
+                LogError(("tls_client_connect: could not resolve %s!", client->host));
+                return tls_client_fail(client);
+            } else if (client->resolve_result == 0) {
+                if (tls_client_phase_ms(client) >= client->config->resolve_timeout_ms) {
+                    LogError(("tls_client_connect: resolving %s timed out!", client->host));
+                    return tls_client_fail(client);
+                }
+
+                return 0;
+            }
+
+            client->connect_times.resolve_ms = tls_client_phase_ms(client);
+
+            if (!client->addr_cached) {
+                dns_cache_store(client->host, &client->addr);
+            }
+
+            if (tls_client_start_tcp(client) != 0) {
+                return tls_client_fail(client);
+            }
+
+            return 0;
+
+        case TLS_CLIENT_STATE_CONNECTING:
+            result = tls_client_poll_tcp(client);
+
+            if (result < 0) {
+                // the address may be stale, look it up again next time
+                dns_cache_invalidate(client->host);
+                return tls_client_fail(client);
+            } else if (result == 0) {
+                if (tls_client_phase_ms(client) >= client->config->connect_timeout_ms) {
+                    LogError(("tls_client_connect: connecting to %s timed out!", client->host));
+                    dns_cache_invalidate(client->host);
+                    return tls_client_fail(client);
+                }
+
+                return 0;
+            }
+
+            client->connect_times.connect_ms = tls_client_phase_ms(client);
+
+            if (tls_client_start_handshake(client) != 0) {
+                return tls_client_fail(client);
+            }
+
+            return 0;
+
+        case TLS_CLIENT_STATE_HANDSHAKING:
+            result = tls_client_poll_handshake(client);
+
+            if (result == 0) {
+                if (tls_client_phase_ms(client) < client->config->handshake_timeout_ms) {
+                    return 0;
+                }
+
+                LogError(("tls_client_connect: TLS handshake with %s timed out!", client->host));
+                result = -1;
+            }
+
+            if (result < 0 && client->session_offered == 1) {
+                // the server may reject a stale session with an alert instead of
+                // falling back itself, so retry once with a full handshake
+                LogWarn(("tls_client_connect: session resumption for %s failed, retrying with full handshake", client->host));
+
+                xSemaphoreTake(session_cache_lock, portMAX_DELAY);
+
+                tls_session_cache_entry_t* entry = tls_session_cache_find(client->host);
+                if (entry != NULL) {
+                    tls_session_cache_invalidate(entry);
+                }
+
+                xSemaphoreGive(session_cache_lock);
+
+                close(client->sock);
+                client->sock = -1;
+                client->session_offered = -1;
+
+                tls_arena_meter_enter(&client->arena_meter);
+                mbedtls_ssl_session_reset(&client->ctx);
+                tls_arena_meter_leave(&client->arena_meter);
+
+                if (tls_client_start_tcp(client) != 0) {
+                    return tls_client_fail(client);
+                }
+
+                return 0;
+            } else if (result < 0) {
+                LogError(("tls_client_connect: TLS handshake with %s failed!", client->host));
+                return tls_client_fail(client);
+            }
+
+            client->connect_times.handshake_ms = tls_client_phase_ms(client);
+
+            if (client->resumed) {
+                session_stats.hits++;
+            } else {
+                session_stats.misses++;
+            }
+
+            LogDebug((
+                "tls_client_connect: %s handshake with %s using %s, resolve = %u ms, connect = %u ms, handshake = %u ms",
+                client->resumed ? "abbreviated" : "full",
+                client->host,
+                mbedtls_ssl_get_ciphersuite(&client->ctx),
+                client->connect_times.resolve_ms,
+                client->connect_times.connect_ms,
+                client->connect_times.handshake_ms
+            ));
+
+            xSemaphoreTake(session_cache_lock, portMAX_DELAY);
+            tls_session_cache_store(client->host, &client->ctx);
+            xSemaphoreGive(session_cache_lock);
+
+            tls_arena_meter_stop(&client->arena_meter);
+
+            // mbedTLS has shrunk the buffers to the negotiated fragment length by now
+            client->memory.in_buf_len = client->ctx.in_buf_len;
+            client->memory.out_buf_len = client->ctx.out_buf_len;
+            client->memory.peak = client->arena_meter.peak;
+
+            LogDebug((
+                "tls_client_connect: %s buffers in = %u, out = %u, peak = %u bytes",
+                client->host,
+                client->memory.in_buf_len,
+                client->memory.out_buf_len,
+                client->memory.peak
+            ));
+
+            // callers expect blocking reads and writes once connected
+            int fiobio = 0;
+            lwip_ioctl(client->sock, FIONBIO, &fiobio);
+
+            client->state = TLS_CLIENT_STATE_CONNECTED;
+
+            return 1;
+
+        case TLS_CLIENT_STATE_CONNECTED:
+            return 1;
+
+        default:
+            return -1;
+    }
+}
+
+int tls_client_connect(tls_client_t* client, const char* host, const char* port)
+{
+    if (tls_client_connect_start(client, host, port) != 0) {
+        return -1;
+    }
+
+    int result;
+
+    while ((result = tls_client_connect_poll(client)) == 0) {
+        vTaskDelay(1);
+    }
+
+    return (result == 1) ? 0 : -1;
+}
+
+int tls_client_connected(tls_client_t* client)
+{
+    return (client->state == TLS_CLIENT_STATE_CONNECTED);
+}
+
 int tls_client_ioctl(tls_client_t* client, long cmd, void* argp)
 {
     return lwip_ioctl(client->sock, cmd, argp);
@@ -125,12 +609,52 @@ int tls_client_read(tls_client_t* client, uint8_t* data, size_t len)
 
 int tls_client_close(tls_client_t* client)
 {
-    close(client->sock);
-    client->sock = -1;
+    tls_arena_meter_stop(&client->arena_meter);
+
+    if (client->sock != -1) {
+        close(client->sock);
+        client->sock = -1;
+    }
+    client->state = TLS_CLIENT_STATE_IDLE;
 
     mbedtls_ssl_free(&client->ctx);
-    mbedtls_ssl_config_free(&client->conf);
-    mbedtls_ctr_drbg_free(&client->ctr_drbg);
-    mbedtls_entropy_free(&client->entropy);
-    mbedtls_x509_crt_free(&client->cacert);
+
+    return 0;
+}
+
+int tls_client_check_idle(tls_client_t* client)
+{
+    uint8_t c;
+
+    if (client->sock == -1) {
+        return -1;
+    }
+
+    // nothing should arrive on an idle connection, so readable data is either
+    // the peer's close (FIN or close_notify) or garbage, neither is reusable
+    int result = lwip_recv(client->sock, &c, sizeof(c), MSG_PEEK | MSG_DONTWAIT);
+
+    if (result == -1 && errno == EAGAIN) {
+        return 0;
+    }
+
+    return -1;
+}
+
+void tls_client_get_session_stats(tls_client_session_stats_t* stats)
+{
+    *stats = session_stats;
+}
+
+void tls_client_clear_session_cache(void)
+{
+    xSemaphoreTake(session_cache_lock, portMAX_DELAY);
+
+    for (int i = 0; i < TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+        if (session_cache[i].valid) {
+            tls_session_cache_invalidate(&session_cache[i]);
+        }
+    }
+
+    xSemaphoreGive(session_cache_lock);
 }
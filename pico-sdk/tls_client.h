@@ -7,25 +7,133 @@
 #ifndef __TLS_CLIENT_H__
 #define __TLS_CLIENT_H__
 
+#include <FreeRTOS.h>
+#include <semphr.h>
+
+#include <lwip/dns.h>
+
 #include <mbedtls/net.h>
 #include <mbedtls/ssl.h>
 #include <mbedtls/entropy.h>
 #include <mbedtls/ctr_drbg.h>
 
-typedef struct {
-    int sock;
+#include "tls_arena.h"
+
+#ifndef TLS_CLIENT_SESSION_CACHE_SIZE
+#define TLS_CLIENT_SESSION_CACHE_SIZE 2
+#endif
+
+#ifndef TLS_CLIENT_HOST_MAX_LEN
+#define TLS_CLIENT_HOST_MAX_LEN 64
+#endif
+
+// asked for with the max_fragment_length extension, I/O buffers shrink to it after the handshake
+#ifndef TLS_CLIENT_MAX_FRAG_LEN
+#define TLS_CLIENT_MAX_FRAG_LEN MBEDTLS_SSL_MAX_FRAG_LEN_2048
+#endif
+
+#ifndef TLS_CLIENT_RESOLVE_TIMEOUT_MS
+#define TLS_CLIENT_RESOLVE_TIMEOUT_MS 5000
+#endif
+
+#ifndef TLS_CLIENT_CONNECT_TIMEOUT_MS
+#define TLS_CLIENT_CONNECT_TIMEOUT_MS 5000
+#endif
+
+#ifndef TLS_CLIENT_HANDSHAKE_TIMEOUT_MS
+#define TLS_CLIENT_HANDSHAKE_TIMEOUT_MS 10000
+#endif
+
+// restricts the ciphersuites and curves offered in the ClientHello
+typedef enum {
+    TLS_CLIENT_PROFILE_DEFAULT,
+    TLS_CLIENT_PROFILE_FAST
+} tls_client_profile_t;
 
+#ifndef TLS_CLIENT_PROFILE
+#define TLS_CLIENT_PROFILE TLS_CLIENT_PROFILE_FAST
+#endif
+
+// shared by all connections, created once at boot
+typedef struct {
     mbedtls_x509_crt cacert;
     mbedtls_entropy_context entropy;
     mbedtls_ctr_drbg_context ctr_drbg;
-    mbedtls_ssl_context ctx;
+    // mbedTLS is built without MBEDTLS_THREADING_C, connections on different
+    // tasks draw from ctr_drbg under this lock
+    SemaphoreHandle_t drbg_lock;
     mbedtls_ssl_config conf;
+
+    uint32_t resolve_timeout_ms;
+    uint32_t connect_timeout_ms;
+    uint32_t handshake_timeout_ms;
+} tls_config_t;
+
+typedef enum {
+    TLS_CLIENT_STATE_IDLE,
+    TLS_CLIENT_STATE_RESOLVING,
+    TLS_CLIENT_STATE_CONNECTING,
+    TLS_CLIENT_STATE_HANDSHAKING,
+    TLS_CLIENT_STATE_CONNECTED,
+    TLS_CLIENT_STATE_FAILED
+} tls_client_state_t;
+
+// how long each phase of the last connect took
+typedef struct {
+    uint32_t resolve_ms;
+    uint32_t connect_ms;
+    uint32_t handshake_ms;
+} tls_client_connect_times_t;
+
+// memory held by the connection, the peak covers the whole connect
+typedef struct {
+    size_t in_buf_len;
+    size_t out_buf_len;
+    size_t peak;
+} tls_client_memory_t;
+
+typedef struct {
+    int sock;
+
+    tls_config_t* config;
+    mbedtls_ssl_context ctx;
+
+    tls_client_state_t state;
+    char host[TLS_CLIENT_HOST_MAX_LEN];
+    uint16_t port;
+    ip_addr_t addr;
+    volatile int resolve_result;
+    int addr_cached;
+    TickType_t phase_start;
+    int session_offered;
+    int resumed;
+    tls_client_connect_times_t connect_times;
+    tls_arena_meter_t arena_meter;
+    tls_client_memory_t memory;
 } tls_client_t;
 
-int tls_client_init(tls_client_t* client, const unsigned char* root_ca, size_t root_ca_len);
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+} tls_client_session_stats_t;
+
+int tls_config_init(tls_config_t* config, const unsigned char* root_ca, size_t root_ca_len);
+
+void tls_config_set_profile(tls_config_t* config, tls_client_profile_t profile);
+
+// draws from the shared DRBG under drbg_lock, arg is the tls_config_t
+int tls_config_random(void* arg, unsigned char* output, size_t output_len);
+
+int tls_client_init(tls_client_t* client, tls_config_t* config);
+
+int tls_client_connect_start(tls_client_t* client, const char* host, const char* port);
+
+int tls_client_connect_poll(tls_client_t* client);
 
 int tls_client_connect(tls_client_t* client, const char* host, const char* port);
 
+int tls_client_connected(tls_client_t* client);
+
 int tls_client_ioctl(tls_client_t* client, long cmd, void* argp);
 
 int tls_client_write(tls_client_t* client, const uint8_t* data, size_t len);
@@ -34,4 +142,10 @@ int tls_client_read(tls_client_t* client, uint8_t* data, size_t len);
 
 int tls_client_close(tls_client_t* client);
 
+int tls_client_check_idle(tls_client_t* client);
+
+void tls_client_get_session_stats(tls_client_session_stats_t* stats);
+
+void tls_client_clear_session_cache(void);
+
 #endif
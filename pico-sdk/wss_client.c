@@ -4,150 +4,1026 @@
 //
 
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
 #include <lwip/sockets.h>
 
 #include <mbedtls/base64.h>
+#include <mbedtls/sha1.h>
+
+#include "pico/time.h"
+
+#include "http_header.h"
+#include "logging.h"
 
 #include "wss_client.h"
+#include "wss_mask.h"
 
-int wss_client_init(
-    wss_client_t* client,
-    const unsigned char* root_ca,
-    size_t root_ca_len,
-    char* buf, size_t
-    buf_len)
+static void wss_client_reset_rx(wss_client_t* client)
 {
-    if (https_client_init(&client->https, root_ca, root_ca_len, buf, buf_len) != 0) {
+    client->rx_start = 0;
+    client->rx_end = 0;
+    client->rx_state = WSS_RX_STATE_HEADER;
+    client->msg_active = 0;
+    client->msg_streaming = 0;
+}
+
+// RFC 6455 section 1.3
+#define WSS_CLIENT_ACCEPT_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+static int wss_client_inflated(void* arg, const uint8_t* data, size_t len);
+static int wss_client_send(wss_client_t* client, const uint8_t* data, size_t len);
+static int wss_client_fill(wss_client_t* client);
+
+static void wss_client_reset_tx(wss_client_t* client)
+{
+    client->tx_len = 0;
+    client->tx_corked = 0;
+}
+
+int wss_client_init(wss_client_t* client, tls_config_t* tls_config)
+{
+    // only the TLS connection is used, frames have their own buffers
+    if (https_client_init(&client->https, tls_config) != 0) {
         return -1;
     }
 
+    client->consumer = NULL;
+    client->consumer_arg = NULL;
+
+    client->deflate_offered = 0;
+    client->deflate = 0;
+    memset(&client->deflate_stats, 0x00, sizeof(client->deflate_stats));
+
+    inflater_init(&client->inflater, client->inflate_window, WSS_CLIENT_DEFLATE_WINDOW_BITS, wss_client_inflated, client);
+
+    client->alive = 0;
+    client->ping_interval_ms = WSS_CLIENT_PING_INTERVAL_MS;
+    client->pong_timeout_ms = WSS_CLIENT_PONG_TIMEOUT_MS;
+    memset(&client->ping_stats, 0x00, sizeof(client->ping_stats));
+
+    wss_client_reset_rx(client);
+    wss_client_reset_tx(client);
+
     return 0;
 }
 
+void wss_client_set_consumer(wss_client_t* client, wss_message_consumer_t consumer, void* arg)
+{
+    client->consumer = consumer;
+    client->consumer_arg = arg;
+}
+
+// offers permessage-deflate on the next ws_client_open
+void wss_client_set_deflate(wss_client_t* client, int deflate)
+{
+    client->deflate_offered = deflate;
+}
+
+void wss_client_get_deflate_stats(wss_client_t* client, wss_deflate_stats_t* stats)
+{
+    memcpy(stats, &client->deflate_stats, sizeof(*stats));
+}
+
+void wss_client_set_ping_interval(wss_client_t* client, uint32_t interval_ms, uint32_t timeout_ms)
+{
+    client->ping_interval_ms = interval_ms;
+    client->pong_timeout_ms = timeout_ms;
+}
+
+void wss_client_get_ping_stats(wss_client_t* client, wss_ping_stats_t* stats)
+{
+    memcpy(stats, &client->ping_stats, sizeof(*stats));
+}
+
+int ws_client_connect_start(wss_client_t* client, const char* host)
+{
+    if (tls_client_init(&client->https.tls, client->https.tls_config) != 0) {
+        return -1;
+    }
+
+    return tls_client_connect_start(&client->https.tls, host, "443");
+}
+
+int ws_client_connect_poll(wss_client_t* client)
+{
+    return tls_client_connect_poll(&client->https.tls);
+}
+
+// checks if the server took up the permessage-deflate offer, returns -1 if it did so on terms we cannot handle
+static int wss_client_deflate_accepted(const char* value, size_t value_len)
+{
+    char extensions[128];
+
+    if (value_len >= sizeof(extensions)) {
+        LogError(("ws_client_open: Sec-WebSocket-Extensions is too long!"));
+        return -1;
+    }
+
+    memcpy(extensions, value, value_len);
+    extensions[value_len] = '\0';
+
+    if (strstr(extensions, "permessage-deflate") == NULL) {
+        LogError(("ws_client_open: server picked an extension that was not offered, extensions = %s", extensions));
+        return -1;
+    }
+
+    const char* window_bits = strstr(extensions, "server_max_window_bits=");
+
+    if (window_bits == NULL || atoi(window_bits + strlen("server_max_window_bits=")) > WSS_CLIENT_DEFLATE_WINDOW_BITS) {
+        LogError(("ws_client_open: server did not agree to a window of %d bits, extensions = %s", WSS_CLIENT_DEFLATE_WINDOW_BITS, extensions));
+        return -1;
+    }
+
+    return 1;
+}
+
+// the Sec-WebSocket-Accept value the server has to answer key_base64 with
+static int wss_client_accept_key(const char* key_base64, char* accept, size_t accept_len)
+{
+    char input[24 + sizeof(WSS_CLIENT_ACCEPT_GUID)];
+    unsigned char hash[20];
+    size_t olen;
+
+    snprintf(input, sizeof(input), "%s%s", key_base64, WSS_CLIENT_ACCEPT_GUID);
+
+    if (mbedtls_sha1_ret((const unsigned char*)input, strlen(input), hash) != 0) {
+        return -1;
+    }
+
+    return mbedtls_base64_encode((unsigned char*)accept, accept_len, &olen, hash, sizeof(hash));
+}
+
+// checks the response header at the start of rx_buf
+static enum HTTPStatus wss_client_check_upgrade(wss_client_t* client, const char* accept, size_t header_len)
+{
+    const char* line = (const char*)client->rx_buf;
+    const char* end = line + header_len;
+    const char* line_end = memchr(line, '\r', end - line);
+    int upgrade = 0;
+    int connection = 0;
+    int accepted = 0;
+    int deflate = 0;
+
+    if (line_end - line < 12 || strncmp(line, "HTTP/1.1 101", 12) != 0) {
+        LogError(("ws_client_open: unexpected response, %.*s", (int)(line_end - line), line));
+        return HTTPInvalidResponse;
+    }
+
+    for (line = line_end + 2; line < end; line = line_end + 2) {
+        line_end = memchr(line, '\r', end - line);
+
+        if (line_end == line) {
+            break;
+        }
+
+        size_t name_len;
+        const char* value;
+        size_t value_len;
+
+        if (http_header_field(line, line_end, &name_len, &value, &value_len) != 0) {
+            LogError(("ws_client_open: invalid header line, %.*s", (int)(line_end - line), line));
+            return HTTPInvalidResponse;
+        }
+
+        if (http_header_is(line, name_len, "Upgrade")) {
+            upgrade = http_header_value_has(value, value_len, "websocket");
+        } else if (http_header_is(line, name_len, "Connection")) {
+            connection = http_header_value_has(value, value_len, "upgrade");
+        } else if (http_header_is(line, name_len, "Sec-WebSocket-Accept")) {
+            accepted = (value_len == strlen(accept) && memcmp(value, accept, value_len) == 0);
+        } else if (http_header_is(line, name_len, "Sec-WebSocket-Extensions")) {
+            deflate = client->deflate_offered ? wss_client_deflate_accepted(value, value_len) : -1;
+        }
+    }
+
+    if (!upgrade || !connection) {
+        LogError(("ws_client_open: response is not a WebSocket upgrade"));
+        return HTTPInvalidResponse;
+    }
+
+    if (!accepted) {
+        LogError(("ws_client_open: Sec-WebSocket-Accept does not match the key"));
+        return HTTPInvalidResponse;
+    }
+
+    if (deflate < 0) {
+        return HTTPInvalidResponse;
+    }
+
+    client->deflate = deflate;
+
+    return HTTPSuccess;
+}
+
+// reads the response header into rx_buf, returns its length or 0 on failure
+static size_t wss_client_read_upgrade(wss_client_t* client, enum HTTPStatus* status)
+{
+    uint64_t start = time_us_64();
+    size_t header_len;
+
+    while ((header_len = http_header_len(client->rx_buf, client->rx_end)) == 0) {
+        if (client->rx_end == sizeof(client->rx_buf)) {
+            LogError(("ws_client_open: response header is larger than buffer size %d", (int)sizeof(client->rx_buf)));
+            *status = HTTPInsufficientMemory;
+            return 0;
+        }
+
+        int result = wss_client_fill(client);
+
+        if (result < 0) {
+            LogError(("ws_client_open: connection closed before the response"));
+            *status = HTTPNetworkError;
+            return 0;
+        } else if (result == 0) {
+            if (time_us_64() - start >= (uint64_t)WSS_CLIENT_UPGRADE_TIMEOUT_MS * 1000) {
+                LogError(("ws_client_open: no response within %d ms", WSS_CLIENT_UPGRADE_TIMEOUT_MS));
+                *status = HTTPNoResponse;
+                return 0;
+            }
+
+            vTaskDelay(1);
+        }
+    }
+
+    return header_len;
+}
+
 enum HTTPStatus ws_client_open(wss_client_t* client, const char* host, const char* path)
 {
     unsigned char key[16];
     char key_base64[24 + 1];
+    char accept[28 + 1];
+    char extensions[96] = "";
+    size_t olen;
 
-    for (int i = 0; i < 16; i += 8) {
-        uint64_t rand64 = get_rand_64();
-        memcpy(&key[i], &rand64, sizeof(rand64));
+    if (tls_config_random(client->https.tls_config, key, sizeof(key)) != 0) {
+        LogError(("ws_client_open: tls_config_random failed!"));
+        return HTTPInvalidParameter;
     }
 
-    size_t olen;
     mbedtls_base64_encode(key_base64, sizeof(key_base64), &olen, key, sizeof(key));
 
-    enum HTTPStatus status = https_client_get(
-        &client->https,
-        host,
+    if (wss_client_accept_key(key_base64, accept, sizeof(accept)) != 0) {
+        LogError(("ws_client_open: wss_client_accept_key failed!"));
+        return HTTPInvalidParameter;
+    }
+
+    if (client->deflate_offered) {
+        // we never compress ourselves, so only the server side is limited
+        snprintf(extensions, sizeof(extensions), "Sec-WebSocket-Extensions: permessage-deflate; server_max_window_bits=%d\r\n", WSS_CLIENT_DEFLATE_WINDOW_BITS);
+    }
+
+    // the connection may already have been set up with ws_client_connect_start
+    if (!tls_client_connected(&client->https.tls)) {
+        if (tls_client_init(&client->https.tls, client->https.tls_config) != 0 ||
+            tls_client_connect(&client->https.tls, host, "443") != 0) {
+            LogError(("ws_client_open: tls_client_connect failed!"));
+            wss_client_close(client);
+            return HTTPNetworkError;
+        }
+    }
+
+    // frames are polled from now on, the response already is
+    int fiobio = 1;
+    tls_client_ioctl(&client->https.tls, FIONBIO, &fiobio);
+
+    wss_client_reset_rx(client);
+    wss_client_reset_tx(client);
+    client->deflate = 0;
+
+    int request_len = snprintf(
+        (char*)client->tx_buf,
+        sizeof(client->tx_buf),
+        "GET %s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: %s\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "%s"
+        "\r\n",
         path,
-        (const char*[]){
-            "Upgrade", "websocket",
-            "Connection", "Upgrade",
-            "Sec-WebSocket-Key", key_base64,
-            "Sec-WebSocket-Version", "13"
-        },
-        4
+        host,
+        key_base64,
+        extensions
     );
 
-    return status;
+    if (request_len < 0 || request_len >= sizeof(client->tx_buf)) {
+        LogError(("ws_client_open: request is larger than buffer size %d", (int)sizeof(client->tx_buf)));
+        wss_client_close(client);
+        return HTTPInsufficientMemory;
+    }
+
+    if (wss_client_send(client, client->tx_buf, request_len) != 0) {
+        wss_client_close(client);
+        return HTTPNetworkError;
+    }
+
+    enum HTTPStatus status = HTTPSuccess;
+    size_t header_len = wss_client_read_upgrade(client, &status);
+
+    if (header_len == 0 || (status = wss_client_check_upgrade(client, accept, header_len)) != HTTPSuccess) {
+        wss_client_close(client);
+        return status;
+    }
+
+    // frames that came in with the response, like Slack's hello, are decoded where they are
+    client->rx_start = header_len;
+
+    inflater_reset(&client->inflater);
+
+    client->alive = 1;
+    client->last_rx_us = time_us_64();
+    client->ping_sent_us = client->last_rx_us;
+    client->ping_outstanding = 0;
+    memset(&client->ping_stats, 0x00, sizeof(client->ping_stats));
+
+    return HTTPSuccess;
 }
 
+// the connection is declared dead by read and write errors and missed pongs,
+// so this does not touch the socket
 int ws_client_connected(wss_client_t* client)
 {
-    if (client->https.tls.sock == -1) {
-        return 0;
-    }
+    return client->alive && client->https.tls.sock != -1;
+}
 
-    int result = tls_client_read(&client->https.tls, NULL, 0);
+// writes all of data, the socket is non-blocking once the connection is open
+static int wss_client_send(wss_client_t* client, const uint8_t* data, size_t len)
+{
+    uint64_t start = time_us_64();
 
-    if (result == 0 || result == MBEDTLS_ERR_SSL_WANT_READ) {
-        return 1;
+    while (len > 0) {
+        int result = tls_client_write(&client->https.tls, data, len);
+
+        if (result == MBEDTLS_ERR_SSL_WANT_READ || result == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            // a peer that stopped reading would otherwise hold up the caller forever
+            if (time_us_64() - start >= (uint64_t)WSS_CLIENT_WRITE_TIMEOUT_MS * 1000) {
+                LogError(("wss_client_send: no progress within %d ms", WSS_CLIENT_WRITE_TIMEOUT_MS));
+                client->alive = 0;
+                return -1;
+            }
+
+            vTaskDelay(1);
+            continue;
+        } else if (result < 0) {
+            LogError(("wss_client_send: tls_client_write failed, result = -0x%x", -result));
+            client->alive = 0;
+            return -1;
+        }
+
+        data += result;
+        len -= result;
     }
 
     return 0;
 }
 
+static int wss_client_send_pending(wss_client_t* client)
+{
+    if (client->tx_len == 0) {
+        return 0;
+    }
+
+    int result = wss_client_send(client, client->tx_buf, client->tx_len);
+
+    client->tx_len = 0;
+
+    return result;
+}
+
 int wss_client_write(wss_client_t* client, uint8_t type, const uint8_t* buf, size_t len)
 {
-    if (len > 0xFFFF) {
+    uint8_t key[4];
+
+    if (tls_config_random(client->https.tls_config, key, sizeof(key)) != 0) {
+        LogError(("wss_client_write: tls_config_random failed!"));
         return -1;
     }
 
-    uint8_t header[8];
-    int header_len = 0;
+    uint8_t header[14];
+    size_t header_len = 0;
 
     header[header_len++] = 0x80 | type;
-    if (len < 126) {    
+    if (len < 126) {
         header[header_len++] = 0x80 | len;
-    } else {
+    } else if (len <= 0xFFFF) {
         header[header_len++] = 0x80 | 126;
         header[header_len++] = (len >> 8) & 0xFF;
         header[header_len++] = (len >> 0) & 0xFF;
+    } else {
+        header[header_len++] = 0x80 | 127;
+        for (int i = 7; i >= 0; i--) {
+            header[header_len++] = ((uint64_t)len >> (i * 8)) & 0xFF;
+        }
     }
 
-    // mask
-    header[header_len++] = 0x00;
-    header[header_len++] = 0x00;
-    header[header_len++] = 0x00;
-    header[header_len++] = 0x00;
+    memcpy(&header[header_len], key, sizeof(key));
+    header_len += sizeof(key);
 
-    if (tls_client_write(&client->https.tls, header, header_len) < 0) {
-        return -1;
+    if (client->tx_len + header_len + len > sizeof(client->tx_buf)) {
+        if (wss_client_send_pending(client) != 0) {
+            return -1;
+        }
+    }
+
+    memcpy(&client->tx_buf[client->tx_len], header, header_len);
+    client->tx_len += header_len;
+
+    // the payload is masked where it lands in the buffer, frames that do not
+    // fit go out in pieces with the header in the same record as the first one
+    size_t pos = 0;
+
+    while (1) {
+        size_t piece = len - pos;
+
+        if (piece > sizeof(client->tx_buf) - client->tx_len) {
+            piece = sizeof(client->tx_buf) - client->tx_len;
+        }
+
+        uint8_t* dst = &client->tx_buf[client->tx_len];
+
+        memcpy(dst, &buf[pos], piece);
+        wss_mask(dst, piece, key, pos);
+
+        client->tx_len += piece;
+        pos += piece;
+
+        if (pos == len) {
+            break;
+        }
+
+        if (wss_client_send_pending(client) != 0) {
+            return -1;
+        }
+    }
+
+    if (client->tx_corked) {
+        return 0;
+    }
+
+    return wss_client_send_pending(client);
+}
+
+// holds back frames from wss_client_write until wss_client_flush
+void wss_client_cork(wss_client_t* client)
+{
+    client->tx_corked = 1;
+}
+
+int wss_client_flush(wss_client_t* client)
+{
+    client->tx_corked = 0;
+
+    return wss_client_send_pending(client);
+}
+
+// parses the frame header at rx_start, returns 0 if more bytes are needed and -1 if it is invalid
+static int wss_client_parse_header(wss_client_t* client)
+{
+    const uint8_t* header = &client->rx_buf[client->rx_start];
+    size_t available = client->rx_end - client->rx_start;
+    size_t header_len = 2;
+
+    if (available < header_len) {
+        return 0;
+    }
+
+    uint8_t length = header[1] & 0x7F;
+
+    if (length == 126) {
+        header_len += 2;
+    } else if (length == 127) {
+        header_len += 8;
+    }
+
+    if (header[1] & 0x80) {
+        header_len += 4;
+    }
+
+    if (available < header_len) {
+        return 0;
+    }
+
+    client->rx_fin = header[0] & 0x80;
+    client->rx_type = header[0] & 0x0F;
+    client->rx_rsv1 = header[0] & 0x40;
+    client->rx_masked = header[1] & 0x80;
+    client->rx_header_len = header_len;
+    client->rx_payload_pos = 0;
+
+    if (length == 126) {
+        client->rx_payload_len = (header[2] << 8) | header[3];
+    } else if (length == 127) {
+        client->rx_payload_len = 0;
+
+        // RFC 6455 section 5.2, the most significant bit must be 0
+        if (header[2] & 0x80) {
+            LogError(("wss_client_read_frame: invalid 64-bit payload length"));
+            return -1;
+        }
+
+        for (int i = 0; i < 8; i++) {
+            client->rx_payload_len = (client->rx_payload_len << 8) | header[2 + i];
+        }
+    } else {
+        client->rx_payload_len = length;
+    }
+
+    if (client->rx_masked) {
+        memcpy(client->rx_mask, &header[header_len - 4], sizeof(client->rx_mask));
+    }
+
+    return 1;
+}
+
+static void wss_client_unmask(wss_client_t* client, uint8_t* data, size_t len)
+{
+    if (!client->rx_masked) {
+        return;
+    }
+
+    wss_mask(data, len, client->rx_mask, client->rx_payload_pos);
+}
+
+// set while the fragments received so far sit in the buffer at msg_start
+static int wss_client_msg_buffered(wss_client_t* client)
+{
+    return client->msg_active && !client->msg_streaming;
+}
+
+// moves the reassembled message and the unread bytes to the start of the buffer
+static void wss_client_compact(wss_client_t* client)
+{
+    size_t unread = client->rx_end - client->rx_start;
+
+    if (wss_client_msg_buffered(client)) {
+        memmove(client->rx_buf, &client->rx_buf[client->msg_start], client->msg_len);
+        memmove(&client->rx_buf[client->msg_len], &client->rx_buf[client->rx_start], unread);
+
+        client->msg_start = 0;
+        client->rx_start = client->msg_len;
+    } else {
+        memmove(client->rx_buf, &client->rx_buf[client->rx_start], unread);
+
+        client->rx_start = 0;
     }
 
-    return tls_client_write(&client->https.tls, buf, len);
+    client->rx_end = client->rx_start + unread;
 }
 
-int wss_client_read(wss_client_t* client, uint8_t* type, uint8_t* buf, size_t len)
+// reads as much as fits into the receive buffer, returns 0 if nothing is available yet
+static int wss_client_fill(wss_client_t* client)
 {
-    int fiobio = 1; 
-    tls_client_ioctl(&client->https.tls, FIONBIO, &fiobio); 
+    if (client->rx_end == sizeof(client->rx_buf)) {
+        wss_client_compact(client);
+    }
 
-    uint8_t header[2];
-    int result = tls_client_read(&client->https.tls, header, sizeof(header));
+    int result = tls_client_read(
+        &client->https.tls,
+        &client->rx_buf[client->rx_end],
+        sizeof(client->rx_buf) - client->rx_end
+    );
 
     if (result == MBEDTLS_ERR_SSL_WANT_READ) {
         return 0;
     } else if (result <= 0) {
-        return result;
+        return -1;
     }
 
-    fiobio = 1; 
-    tls_client_ioctl(&client->https.tls, FIONBIO, &fiobio);
+    client->rx_end += result;
 
-    *type = header[0] & 0x7F;
-    int msg_length = header[1];
+    return result;
+}
+
+// passes message data on to the consumer
+static int wss_client_deliver(wss_client_t* client, const uint8_t* data, size_t len, int last)
+{
+    int result = client->consumer(client->consumer_arg, client->msg_type, data, len, client->msg_offset, last);
 
-    if (msg_length == 126) {
-        result = tls_client_read(&client->https.tls, header, sizeof(header));
+    client->msg_offset += len;
 
-        if (result <= 0) {
+    return result;
+}
+
+// collects inflated data in inflate_buf, moving on to the consumer once it does not fit
+static int wss_client_inflated(void* arg, const uint8_t* data, size_t len)
+{
+    wss_client_t* client = (wss_client_t*)arg;
+
+    client->deflate_stats.inflated_bytes += len;
+
+    if (!client->inflate_overflow) {
+        if (client->inflate_len + len <= sizeof(client->inflate_buf)) {
+            memcpy(&client->inflate_buf[client->inflate_len], data, len);
+            client->inflate_len += len;
+
+            return 0;
+        }
+
+        if (client->consumer == NULL) {
+            LogError(("wss_client_read_frame: inflated message is larger than buffer size %d", (int)sizeof(client->inflate_buf)));
             return -1;
         }
 
-        msg_length = (header[0] << 8) | header[1];
-    } else if (msg_length == 127) {
-        // unsupported size
-        LogError(("wss_client_read: received message of length > 65535"))
+        client->inflate_overflow = 1;
 
-        wss_client_close(client);
+        if (client->inflate_len > 0 && wss_client_deliver(client, client->inflate_buf, client->inflate_len, 0) != 0) {
+            return -1;
+        }
+    }
+
+    return wss_client_deliver(client, data, len, 0);
+}
+
+static int wss_client_inflate(wss_client_t* client, const uint8_t* data, size_t len)
+{
+    while (len > 0) {
+        int used = inflater_write(&client->inflater, data, len);
+
+        if (used < 0) {
+            LogError(("wss_client_read_frame: could not inflate message"));
+            return -1;
+        }
+
+        if (inflater_finished(&client->inflater)) {
+            // the server ended its deflate stream, whatever follows starts a new one
+            inflater_reset(&client->inflater);
+        }
+
+        data += used;
+        len -= used;
+    }
+
+    return 0;
+}
+
+static int wss_client_consume(wss_client_t* client, const uint8_t* data, size_t len, int last)
+{
+    if (!client->msg_compressed) {
+        return wss_client_deliver(client, data, len, last);
+    }
+
+    // RFC 7692 strips the empty block that ends every compressed message
+    static const uint8_t tail[] = { 0x00, 0x00, 0xFF, 0xFF };
+
+    uint64_t start = time_us_64();
+
+    int result = wss_client_inflate(client, data, len);
+
+    if (result == 0 && last) {
+        result = wss_client_inflate(client, tail, sizeof(tail));
+    }
+
+    client->deflate_stats.compressed_bytes += len;
+    client->deflate_stats.inflate_us += time_us_64() - start;
+
+    if (result != 0) {
         return -1;
     }
 
-    if (msg_length > len) {
-        // unsupported size
-        LogError(("wss_client_read: got message of length %d, which was larger than buffer size %d", msg_length, len))
+    if (last) {
+        client->deflate_stats.messages++;
+
+        if (client->inflate_overflow) {
+            return wss_client_deliver(client, client->inflate_buf, 0, 1);
+        }
+    }
+
+    return 0;
+}
+
+// checks the header that was just parsed and picks how its payload is received
+static int wss_client_start_frame(wss_client_t* client)
+{
+    if (client->rx_type & 0x08) {
+        // control frames may be sent in between fragments, but are never fragmented themselves
+        if (!client->rx_fin || client->rx_payload_len > 125 || client->rx_rsv1) {
+            LogError(("wss_client_read_frame: invalid control frame"));
+            return -1;
+        }
+
+        // fragments leave room for it, see below
+        if (wss_client_msg_buffered(client) && client->rx_payload_len > sizeof(client->rx_buf) - client->msg_len - client->rx_header_len) {
+            LogError(("wss_client_read_frame: no room for control frame"));
+            return -1;
+        }
+
+        client->rx_state = WSS_RX_STATE_PAYLOAD;
+        return 0;
+    }
+
+    if (client->rx_type == WEBSOCKET_OPCODE_CONTINUATION) {
+        if (!client->msg_active) {
+            LogError(("wss_client_read_frame: continuation frame without a message"));
+            return -1;
+        }
+
+        if (client->rx_rsv1) {
+            LogError(("wss_client_read_frame: continuation frame with RSV1 set"));
+            return -1;
+        }
+    } else {
+        if (client->msg_active) {
+            LogError(("wss_client_read_frame: new message before the last one finished"));
+            return -1;
+        }
+
+        if (client->rx_rsv1 && !client->deflate) {
+            LogError(("wss_client_read_frame: compressed message without permessage-deflate"));
+            return -1;
+        }
+
+        client->msg_active = 1;
+        client->msg_type = client->rx_type;
+        client->msg_start = client->rx_start;
+        client->msg_len = 0;
+        client->msg_offset = 0;
+
+        // compressed messages do not need to fit in the receive buffer, only once inflated
+        client->msg_compressed = client->rx_rsv1;
+        client->msg_streaming = client->msg_compressed;
+        client->inflate_len = 0;
+        client->inflate_overflow = 0;
+    }
+
+    // the message and this header are in the buffer already, so the room left cannot underflow,
+    // fragments that are not the last leave room for a control frame that may come in between
+    size_t room = sizeof(client->rx_buf) - client->msg_len - client->rx_header_len;
+    size_t headroom = client->rx_fin ? 0 : WSS_CLIENT_CONTROL_FRAME_MAX_LEN;
+
+    room = (room > headroom) ? room - headroom : 0;
+
+    if (!client->msg_streaming && client->rx_payload_len > room) {
+        if (client->consumer == NULL) {
+            // unsupported size
+            LogError(("wss_client_read_frame: got message of length %llu, which was larger than buffer size %d", (unsigned long long)(client->msg_len + client->rx_payload_len), (int)sizeof(client->rx_buf)));
+            return -1;
+        }
+
+        // hand over what was reassembled so far, the rest follows as it arrives
+        client->msg_streaming = 1;
+
+        if (client->msg_len > 0 && wss_client_consume(client, &client->rx_buf[client->msg_start], client->msg_len, 0) != 0) {
+            return -1;
+        }
+    }
+
+    if (client->msg_streaming) {
+        client->rx_start += client->rx_header_len;
+        client->rx_state = WSS_RX_STATE_STREAM;
+    } else {
+        client->rx_state = WSS_RX_STATE_PAYLOAD;
+    }
+
+    return 0;
+}
+
+// returns 1 with a complete message or control frame, 0 if none is available yet
+static int wss_client_finish_frame(wss_client_t* client, wss_frame_t* frame)
+{
+    uint8_t* payload = &client->rx_buf[client->rx_start + client->rx_header_len];
+    size_t len = client->rx_payload_len;
+
+    wss_client_unmask(client, payload, len);
+
+    client->rx_state = WSS_RX_STATE_HEADER;
+
+    // a final continuation frame completes a fragmented message, even when the fragments before it were empty
+    if ((client->rx_type & 0x08) || (client->rx_fin && client->rx_type != WEBSOCKET_OPCODE_CONTINUATION)) {
+        // control frame or unfragmented message, return it where it is
+        if (!(client->rx_type & 0x08)) {
+            client->msg_active = 0;
+        }
+
+        frame->type = client->rx_type;
+        frame->payload = payload;
+        frame->len = len;
+
+        client->rx_start += client->rx_header_len + len;
+
+        return 1;
+    }
+
+    // append the payload to the message, dropping the header and any
+    // control frame that came in between, unread bytes move along with it
+    uint8_t* end = &client->rx_buf[client->msg_start + client->msg_len];
+
+    if (end != payload) {
+        size_t gap = payload - end;
+
+        memmove(end, payload, &client->rx_buf[client->rx_end] - payload);
+        client->rx_end -= gap;
+    }
+
+    client->msg_len += len;
+    client->rx_start = client->msg_start + client->msg_len;
+
+    if (!client->rx_fin) {
+        return 0;
+    }
+
+    client->msg_active = 0;
+
+    frame->type = client->msg_type;
+    frame->payload = &client->rx_buf[client->msg_start];
+    frame->len = client->msg_len;
+
+    return 1;
+}
+
+// passes the payload bytes that have arrived on to the consumer, returns 1 when
+// that completes a compressed message which fit in inflate_buf
+static int wss_client_stream_frame(wss_client_t* client, wss_frame_t* frame)
+{
+    uint64_t remaining = client->rx_payload_len - client->rx_payload_pos;
+    size_t len = client->rx_end - client->rx_start;
+
+    if (len > remaining) {
+        len = remaining;
+    }
+
+    if (len == 0 && remaining > 0) {
+        return 0;
+    }
+
+    uint8_t* data = &client->rx_buf[client->rx_start];
+    int last = client->rx_fin && (len == remaining);
+
+    wss_client_unmask(client, data, len);
+
+    if (wss_client_consume(client, data, len, last) != 0) {
+        return -1;
+    }
+
+    client->rx_start += len;
+    client->rx_payload_pos += len;
+
+    if (client->rx_payload_pos == client->rx_payload_len) {
+        client->rx_state = WSS_RX_STATE_HEADER;
+
+        if (client->rx_fin) {
+            client->msg_active = 0;
+            client->msg_streaming = 0;
+
+            if (client->msg_compressed && !client->inflate_overflow) {
+                frame->type = client->msg_type;
+                frame->payload = client->inflate_buf;
+                frame->len = client->inflate_len;
+
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// sends pings on schedule, returns -1 once the server stopped answering
+static int wss_client_keep_alive(wss_client_t* client)
+{
+    uint64_t now = time_us_64();
+
+    if (client->ping_outstanding) {
+        if (now - client->ping_sent_us < (uint64_t)client->pong_timeout_ms * 1000) {
+            return 0;
+        }
+
+        if (client->last_rx_us < client->ping_sent_us) {
+            LogError(("wss_client_read_frame: no pong or other data within %u ms", client->pong_timeout_ms));
+            return -1;
+        }
+
+        // the server is sending, just not answering pings
+        client->ping_outstanding = 0;
+    }
+
+    if (client->ping_interval_ms == 0 || now - client->ping_sent_us < (uint64_t)client->ping_interval_ms * 1000) {
+        return 0;
+    }
+
+    // the send time goes out as the payload, so the pong carries it back
+    client->ping_sent_us = now;
+    client->ping_outstanding = 1;
+    client->ping_stats.pings++;
+
+    if (wss_client_write(client, WEBSOCKET_OPCODE_PING, (const uint8_t*)&client->ping_sent_us, sizeof(client->ping_sent_us)) != 0) {
+        return -1;
+    }
+
+    // sent now even when corked, otherwise the rtt would include the wait for the next flush
+    return wss_client_send_pending(client);
+}
+
+static void wss_client_pong(wss_client_t* client, const wss_frame_t* frame)
+{
+    if (!client->ping_outstanding || frame->len != sizeof(client->ping_sent_us) || memcmp(frame->payload, &client->ping_sent_us, frame->len) != 0) {
+        // unsolicited or late
+        return;
+    }
+
+    uint32_t rtt_us = time_us_64() - client->ping_sent_us;
+
+    client->ping_outstanding = 0;
+    client->ping_stats.pongs++;
+    client->ping_stats.rtt_us = rtt_us;
+
+    // smoothed like TCP's SRTT, RFC 6298
+    if (client->ping_stats.pongs == 1) {
+        client->ping_stats.srtt_us = rtt_us;
+    } else {
+        client->ping_stats.srtt_us = client->ping_stats.srtt_us - client->ping_stats.srtt_us / 8 + rtt_us / 8;
+    }
+}
+
+int wss_client_read_frame(wss_client_t* client, wss_frame_t* frame)
+{
+    if (!client->alive) {
+        return -1;
+    }
+
+    if (wss_client_keep_alive(client) != 0) {
         wss_client_close(client);
         return -1;
     }
 
-    return tls_client_read(&client->https.tls, buf, msg_length);
+    while (1) {
+        if (client->rx_start == client->rx_end && !wss_client_msg_buffered(client)) {
+            // everything consumed, start over at the beginning of the buffer
+            client->rx_start = 0;
+            client->rx_end = 0;
+        }
+
+        if (client->rx_state == WSS_RX_STATE_HEADER) {
+            int parsed = wss_client_parse_header(client);
+
+            if (parsed < 0) {
+                wss_client_close(client);
+                return -1;
+            }
+
+            if (parsed) {
+                if (wss_client_start_frame(client) != 0) {
+                    wss_client_close(client);
+                    return -1;
+                }
+
+                continue;
+            }
+        } else if (client->rx_state == WSS_RX_STATE_PAYLOAD) {
+            if (client->rx_payload_len <= client->rx_end - client->rx_start - client->rx_header_len) {
+                if (!wss_client_finish_frame(client, frame)) {
+                    continue;
+                }
+
+                if (frame->type == WEBSOCKET_OPCODE_PONG) {
+                    wss_client_pong(client, frame);
+                    continue;
+                }
+
+                return 1;
+            }
+        } else if (client->rx_start < client->rx_end || client->rx_payload_pos == client->rx_payload_len) {
+            int result = wss_client_stream_frame(client, frame);
+
+            if (result < 0) {
+                wss_client_close(client);
+                return -1;
+            } else if (result == 1) {
+                return 1;
+            }
+
+            continue;
+        }
+
+        int result = wss_client_fill(client);
+
+        if (result < 0) {
+            client->alive = 0;
+            return -1;
+        } else if (result == 0) {
+            return 0;
+        }
+
+        client->last_rx_us = time_us_64();
+    }
 }
 
 int wss_client_close(wss_client_t* client)
 {
     tls_client_close(&client->https.tls);
 
+    client->deflate = 0;
+    client->alive = 0;
+
+    wss_client_reset_rx(client);
+    wss_client_reset_tx(client);
+
     return 0;
 }
@@ -8,24 +8,160 @@
 #define __WSS_CLIENT_H_
 
 #include "https_client.h"
+#include "inflater.h"
+
+#ifndef WSS_CLIENT_RX_BUF_LEN
+#define WSS_CLIENT_RX_BUF_LEN 2048
+#endif
+
+// outgoing frames are gathered here, keep it within MBEDTLS_SSL_OUT_CONTENT_LEN
+// so that a flush goes out as a single TLS record
+#ifndef WSS_CLIENT_TX_BUF_LEN
+#define WSS_CLIENT_TX_BUF_LEN 1024
+#endif
+
+// permessage-deflate window the server is asked to stay within, 8 to 15 bits
+#ifndef WSS_CLIENT_DEFLATE_WINDOW_BITS
+#define WSS_CLIENT_DEFLATE_WINDOW_BITS 11
+#endif
+
+// how long ws_client_open waits for the 101 response
+#ifndef WSS_CLIENT_UPGRADE_TIMEOUT_MS
+#define WSS_CLIENT_UPGRADE_TIMEOUT_MS 10000
+#endif
+
+// a ping is sent this often, 0 turns client pings off
+#ifndef WSS_CLIENT_PING_INTERVAL_MS
+#define WSS_CLIENT_PING_INTERVAL_MS 30000
+#endif
+
+// the connection is dropped if neither the pong nor anything else arrives within this
+#ifndef WSS_CLIENT_PONG_TIMEOUT_MS
+#define WSS_CLIENT_PONG_TIMEOUT_MS 10000
+#endif
+
+// the connection is dropped if a frame cannot be written within this
+#ifndef WSS_CLIENT_WRITE_TIMEOUT_MS
+#define WSS_CLIENT_WRITE_TIMEOUT_MS 10000
+#endif
+
+// largest control frame, 125 bytes of payload after a header with a mask
+#define WSS_CLIENT_CONTROL_FRAME_MAX_LEN (2 + 4 + 125)
+
+// compressed messages are returned from here if they fit once inflated
+#ifndef WSS_CLIENT_INFLATE_BUF_LEN
+#define WSS_CLIENT_INFLATE_BUF_LEN 4096
+#endif
+
+typedef enum {
+    WSS_RX_STATE_HEADER,
+    WSS_RX_STATE_PAYLOAD,
+    WSS_RX_STATE_STREAM
+} wss_rx_state_t;
+
+// view of a received frame, only valid until the next wss_client_read_frame call
+typedef struct {
+    uint8_t type;
+    uint8_t* payload;
+    size_t len;
+} wss_frame_t;
+
+typedef struct {
+    uint32_t messages;
+    uint32_t compressed_bytes;
+    uint32_t inflated_bytes;
+    uint32_t inflate_us;
+} wss_deflate_stats_t;
+
+typedef struct {
+    uint32_t pings;
+    uint32_t pongs;
+    // last round trip time and a smoothed average of them
+    uint32_t rtt_us;
+    uint32_t srtt_us;
+} wss_ping_stats_t;
+
+// receives messages that do not fit in the receive buffer, chunk by chunk,
+// offset is the position of data in the message and last is set on its final chunk
+typedef int (*wss_message_consumer_t)(void* arg, uint8_t type, const uint8_t* data, size_t len, uint64_t offset, int last);
 
 typedef struct {
     https_client_t https;
+
+    uint8_t rx_buf[WSS_CLIENT_RX_BUF_LEN];
+    size_t rx_start;
+    size_t rx_end;
+
+    // current frame
+    wss_rx_state_t rx_state;
+    uint8_t rx_type;
+    uint8_t rx_fin;
+    uint8_t rx_rsv1;
+    uint8_t rx_mask[4];
+    int rx_masked;
+    size_t rx_header_len;
+    uint64_t rx_payload_len;
+    uint64_t rx_payload_pos;
+
+    // current message, fragments are reassembled in place at msg_start
+    int msg_active;
+    int msg_streaming;
+    uint8_t msg_type;
+    int msg_compressed;
+    size_t msg_start;
+    size_t msg_len;
+    uint64_t msg_offset;
+
+    wss_message_consumer_t consumer;
+    void* consumer_arg;
+
+    // permessage-deflate, compressed messages are always inflated as they arrive
+    int deflate_offered;
+    int deflate;
+    inflater_t inflater;
+    uint8_t inflate_window[1 << WSS_CLIENT_DEFLATE_WINDOW_BITS];
+    uint8_t inflate_buf[WSS_CLIENT_INFLATE_BUF_LEN];
+    size_t inflate_len;
+    int inflate_overflow;
+    wss_deflate_stats_t deflate_stats;
+
+    // liveness, set while the connection is open and answering
+    int alive;
+    uint32_t ping_interval_ms;
+    uint32_t pong_timeout_ms;
+    uint64_t last_rx_us;
+    uint64_t ping_sent_us;
+    int ping_outstanding;
+    wss_ping_stats_t ping_stats;
+
+    // frames written while corked wait here until wss_client_flush
+    uint8_t tx_buf[WSS_CLIENT_TX_BUF_LEN];
+    size_t tx_len;
+    int tx_corked;
 } wss_client_t;
 
+#define WEBSOCKET_OPCODE_CONTINUATION     0x0
 #define WEBSOCKET_OPCODE_TEXT             0x1
 #define WEBSOCKET_OPCODE_BINARY           0x2
 #define WEBSOCKET_OPCODE_CONNECTION_CLOSE 0x8
 #define WEBSOCKET_OPCODE_PING             0x9
 #define WEBSOCKET_OPCODE_PONG             0xA
 
-int wss_client_init(
-    wss_client_t* client,
-    const unsigned char* root_ca,
-    size_t root_ca_len,
-    char* buf,
-    size_t buf_len
-);
+int wss_client_init(wss_client_t* client, tls_config_t* tls_config);
+
+void wss_client_set_consumer(wss_client_t* client, wss_message_consumer_t consumer, void* arg);
+
+void wss_client_set_deflate(wss_client_t* client, int deflate);
+
+void wss_client_get_deflate_stats(wss_client_t* client, wss_deflate_stats_t* stats);
+
+void wss_client_set_ping_interval(wss_client_t* client, uint32_t interval_ms, uint32_t timeout_ms);
+
+void wss_client_get_ping_stats(wss_client_t* client, wss_ping_stats_t* stats);
+
+int ws_client_connect_start(wss_client_t* client, const char* host);
+
+int ws_client_connect_poll(wss_client_t* client);
 
 enum HTTPStatus ws_client_open(wss_client_t* client, const char* host, const char* path);
 
@@ -33,7 +169,11 @@ int ws_client_connected(wss_client_t* client);
 
 int wss_client_write(wss_client_t* client, uint8_t type, const uint8_t* buf, size_t len);
 
-int wss_client_read(wss_client_t* client, uint8_t* type, uint8_t* buf, size_t len);
+void wss_client_cork(wss_client_t* client);
+
+int wss_client_flush(wss_client_t* client);
+
+int wss_client_read_frame(wss_client_t* client, wss_frame_t* frame);
 
 int wss_client_close(wss_client_t* client);
 
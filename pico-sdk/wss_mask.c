@@ -0,0 +1,52 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+#include <string.h>
+
+#include "wss_mask.h"
+
+void wss_mask(uint8_t* data, size_t len, const uint8_t key[4], uint64_t offset)
+{
+    size_t i = 0;
+
+    // the Cortex-M0+ has no unaligned loads, so go byte by byte up to a word boundary
+    while (i < len && ((uintptr_t)&data[i] & 3) != 0) {
+        data[i] ^= key[(offset + i) & 3];
+        i++;
+    }
+
+    size_t words = (len - i) / 4;
+
+    if (words > 0) {
+        // the key as it lines up with the words from here on
+        uint8_t rotated[4];
+        uint32_t mask;
+
+        for (int j = 0; j < 4; j++) {
+            rotated[j] = key[(offset + i + j) & 3];
+        }
+        memcpy(&mask, rotated, sizeof(mask));
+
+        uint32_t* p = (uint32_t*)&data[i];
+        size_t n = words;
+
+        for (; n >= 4; n -= 4, p += 4) {
+            p[0] ^= mask;
+            p[1] ^= mask;
+            p[2] ^= mask;
+            p[3] ^= mask;
+        }
+
+        for (; n > 0; n--, p++) {
+            *p ^= mask;
+        }
+
+        i += words * 4;
+    }
+
+    for (; i < len; i++) {
+        data[i] ^= key[(offset + i) & 3];
+    }
+}
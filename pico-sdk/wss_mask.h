@@ -0,0 +1,17 @@
+//
+// SPDX-FileCopyrightText: Copyright 2023 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+//
+
+
+#ifndef __WSS_MASK_H__
+#define __WSS_MASK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// XORs data in place with the 4 byte WebSocket masking key, offset is the
+// position of data in the payload so a payload can be masked piece by piece
+void wss_mask(uint8_t* data, size_t len, const uint8_t key[4], uint64_t offset);
+
+#endif